@@ -0,0 +1,104 @@
+#include "AllocationCounter.h"
+
+#ifdef GLITCH_COUNT_ALLOCATIONS
+
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> allocationCount(0);
+static thread_local bool counting = false;
+
+//--------------------------------------------------------------
+void countAllocations(bool enable) {
+	counting = enable;
+}
+
+//--------------------------------------------------------------
+uint64_t getAllocationCount() {
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+static void* allocate(size_t size) {
+	if (counting) {
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+	}
+	return std::malloc(size ? size : 1);
+}
+
+//Replaces the global operator new for the whole program.
+void* operator new(size_t size) {
+	void* pointer = allocate(size);
+	if (!pointer) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+//cv::Mat buffers come from cv::fastMalloc, not operator new. This allocator counts them and leaves the
+//work to the standard one, which also frees them.
+class CountingMatAllocator : public cv::MatAllocator {
+
+	public:
+#if CV_VERSION_MAJOR >= 4
+		typedef cv::AccessFlag AccessFlags;
+#else
+		typedef int AccessFlags;
+#endif
+
+		cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, AccessFlags flags, cv::UMatUsageFlags usageFlags) const override {
+			if (counting && !data) {
+				allocationCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+		}
+
+		bool allocate(cv::UMatData* data, AccessFlags accessFlags, cv::UMatUsageFlags usageFlags) const override {
+			return cv::Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+		}
+
+		void deallocate(cv::UMatData* data) const override {
+			cv::Mat::getStdAllocator()->deallocate(data);
+		}
+};
+
+//Installed before main.
+static struct InstallMatAllocator {
+	InstallMatAllocator() {
+		static CountingMatAllocator allocator;
+		cv::Mat::setDefaultAllocator(&allocator);
+	}
+} installMatAllocator;
+
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+//Debug builds count the heap allocations (operator new and cv::Mat buffers) made by the threads that
+//process frames, so that the frame path can check it no longer allocates once it runs steady.
+//Release builds compile the counter out.
+#ifndef NDEBUG
+#define GLITCH_COUNT_ALLOCATIONS
+#endif
+
+#ifdef GLITCH_COUNT_ALLOCATIONS
+
+//Starts or stops counting the allocations of the calling thread.
+void countAllocations(bool enable);
+
+//Allocations made by counting threads since start.
+uint64_t getAllocationCount();
+
+#else
+
+inline void countAllocations(bool enable) {}
+inline uint64_t getAllocationCount() { return 0; }
+
+#endif
@@ -0,0 +1,301 @@
+#include "BatchRenderer.h"
+#include "Postprocess.h"
+#include "GlitchRandom.h"
+#include "EffectChain.h"
+#include "BlockingQueue.h"
+#include "FrameRecorder.h"
+#include "DataPath.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+using namespace cv;
+
+namespace {
+
+struct Frame {
+	int index;
+	Mat mat;
+};
+
+//--------------------------------------------------------------
+bool isSequence(const std::string& path) {
+	return FrameRecorder::getFormat(path) == FrameRecorder::FORMAT_IMAGES;
+}
+
+//Either a video file or a numbered image sequence, frames come out as RGB like the grabber's.
+class FrameSource {
+
+	public:
+		bool open(const std::string& input, int firstFrame) {
+			path = input;
+			index = firstFrame;
+			if (isSequence(path)) {
+				return !imread(FrameRecorder::formatSequencePath(path, index)).empty();
+			}
+			if (!capture.open(path)) {
+				return false;
+			}
+			Mat skipped;
+			for (int i = 0; i < firstFrame; i++) {
+				if (!capture.read(skipped)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool read(Mat& OutRGB, int& OutIndex) {
+			Mat bgr;
+			if (isSequence(path)) {
+				bgr = imread(FrameRecorder::formatSequencePath(path, index), IMREAD_COLOR);
+			}
+			else if (!capture.read(bgr)) {
+				return false;
+			}
+			if (bgr.empty()) {
+				return false;
+			}
+			cvtColor(bgr, OutRGB, COLOR_BGR2RGB);
+			OutIndex = index++;
+			return true;
+		}
+
+		//Frame rate of a video, image sequences have none and play at 30.
+		double getFps() const {
+			double fps = isSequence(path) ? 0 : capture.get(CAP_PROP_FPS);
+			return fps > 0 ? fps : 30;
+		}
+
+	private:
+		std::string path;
+		VideoCapture capture;
+		int index = 0;
+};
+
+//--------------------------------------------------------------
+void printUsage() {
+	std::string effects;
+	for (auto& entry : getPostprocessList()) {
+		effects += std::string(effects.empty() ? "" : ", ") + entry.name;
+	}
+	std::cerr << "usage: InteractiveGlitchArtPostprocessing --render <input> <output pattern> [options]\n"
+		<< "  input             video file or image sequence such as in/frame_%05d.png\n"
+		<< "  output            image sequence such as out/frame_%05d.png, raw out.y4m or video out.mp4\n"
+		<< "  --effect name,... " << effects << " (default splitRGB1)\n"
+		<< "                    several names are applied in order\n"
+		<< "  --background file background image in data/ (default cyber.png)\n"
+		<< "  --alpha value     camera alpha in [0, 1] (default 0.3)\n"
+		<< "  --mask-scale n    motion mask at 1/n of the frame size (default 1)\n"
+		<< "  --threads n       processing threads (default all cores)\n"
+		<< "  --writers n       encoding threads of image sequences (default 2)\n"
+		<< "  --start n         first input frame (default 0)\n"
+		<< "  --frames n        number of frames to render (default all)\n"
+		<< "  --history n       earlier frames kept for timeScanLine and freezeBlock (default 4)\n"
+		<< "  --seed n          base random seed, printed when not given\n";
+}
+
+}
+
+//--------------------------------------------------------------
+bool parseBatchRenderArgs(int argc, char* argv[], BatchRenderSettings& settings) {
+	std::vector<std::string> positional;
+	//Option whose value is being parsed, named when std::sto* rejects the value.
+	std::string option;
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			option = arg;
+			bool hasValue = i + 1 < argc;
+			if (arg == "--render") {
+				continue;
+			}
+			else if (arg == "--effect" && hasValue) {
+				settings.effect = argv[++i];
+			}
+			else if (arg == "--background" && hasValue) {
+				settings.background = argv[++i];
+			}
+			else if (arg == "--alpha" && hasValue) {
+				settings.alphaCam = std::min(1.0f, std::max(0.0f, std::stof(argv[++i])));
+			}
+			else if (arg == "--mask-scale" && hasValue) {
+				settings.maskScale = std::max(1, std::stoi(argv[++i]));
+			}
+			else if (arg == "--threads" && hasValue) {
+				settings.threads = std::stoul(argv[++i]);
+			}
+			else if (arg == "--writers" && hasValue) {
+				settings.writers = std::max(1ul, std::stoul(argv[++i]));
+			}
+			else if (arg == "--start" && hasValue) {
+				settings.firstFrame = std::stoi(argv[++i]);
+			}
+			else if (arg == "--frames" && hasValue) {
+				settings.maxFrames = std::stoi(argv[++i]);
+			}
+			else if (arg == "--history" && hasValue) {
+				settings.historyDepth = std::max(0, std::stoi(argv[++i]));
+			}
+			else if (arg == "--seed" && hasValue) {
+				if (!parseSeed(argv[++i], settings.seed)) {
+					std::cerr << "invalid seed " << argv[i] << "\n";
+					printUsage();
+					return false;
+				}
+				settings.hasSeed = true;
+			}
+			else if (arg.compare(0, 2, "--") == 0) {
+				std::cerr << "unknown option " << arg << "\n";
+				printUsage();
+				return false;
+			}
+			else {
+				positional.push_back(arg);
+			}
+		}
+	}
+	catch (const std::logic_error&) {
+		std::cerr << "invalid value for " << option << "\n";
+		printUsage();
+		return false;
+	}
+	if (positional.size() != 2) {
+		printUsage();
+		return false;
+	}
+	settings.input = positional[0];
+	settings.output = positional[1];
+	for (auto& path : positional) {
+		if (isSequence(path) && !FrameRecorder::isValidSequencePattern(path)) {
+			std::cerr << "invalid image sequence pattern " << path << ", expected one integer field such as %05d\n";
+			printUsage();
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+int runBatchRender(const BatchRenderSettings& settings) {
+
+	//A comma separated list of effects runs as one fused chain.
+	EffectChain effectChain;
+	std::stringstream effects(settings.effect);
+	std::string effect;
+	while (std::getline(effects, effect, ',')) {
+		if (!effectChain.append(effect)) {
+			std::cerr << "unknown effect " << effect << "\n";
+			printUsage();
+			return 1;
+		}
+	}
+
+	//Same background the app loads, kept in RGB like ofImage.
+	Mat matImg = imread(getDataPath(settings.background), IMREAD_COLOR);
+	if (matImg.empty()) {
+		std::cerr << "cannot load background " << settings.background << "\n";
+		return 1;
+	}
+	cvtColor(matImg, matImg, COLOR_BGR2RGB);
+
+	FrameSource source;
+	if (!source.open(settings.input, settings.firstFrame)) {
+		std::cerr << "cannot open input " << settings.input << "\n";
+		return 1;
+	}
+
+	//Frame seeds derive from the base seed and the input frame number, so any frame can be rendered again alone
+	//(the stripe and temporal effects excepted, their noise cache and frame history carry over from the frames before).
+	uint64_t baseSeed = settings.hasSeed ? settings.seed : std::random_device()();
+	std::cout << "seed " << baseSeed << "\n";
+	ThreadPool threadPool(settings.threads ? settings.threads : std::thread::hardware_concurrency());
+	setPostprocessPool(&threadPool);
+
+	//Decoding and encoding run beside the pool, so the cores only wait on the effect itself.
+	//Offline every frame counts, the recorder holds the loop back instead of dropping.
+	FrameRecorder recorder;
+	FrameRecorder::Settings recordSettings;
+	recordSettings.path = settings.output;
+	recordSettings.rows = matImg.rows;
+	recordSettings.cols = matImg.cols;
+	recordSettings.fps = source.getFps();
+	recordSettings.queueFrames = settings.writers * 2;
+	recordSettings.threads = settings.writers;
+	recordSettings.fullPolicy = FrameRecorder::FULL_WAIT;
+	if (!recorder.start(recordSettings)) {
+		std::cerr << "cannot write " << settings.output << "\n";
+		setPostprocessPool(nullptr);
+		return 1;
+	}
+	BlockingQueue<Frame> decoded(4);
+
+	std::thread reader([&] {
+		Frame frame;
+		int count = 0;
+		while ((settings.maxFrames < 0 || count < settings.maxFrames) && source.read(frame.mat, frame.index)) {
+			//The merge needs the camera at background size, as videoGrabber.setup() does.
+			if (frame.mat.cols != matImg.cols || frame.mat.rows != matImg.rows) {
+				resize(frame.mat, frame.mat, matImg.size(), 0, 0, INTER_AREA);
+			}
+			decoded.push(std::move(frame));
+			frame = Frame();
+			count++;
+		}
+		decoded.close();
+	});
+
+	auto start = std::chrono::steady_clock::now();
+	int rendered = 0;
+	//One merge buffer per history frame and one for the current frame. The history hands back the buffer of the
+	//frame it drops, which is the next one to merge into.
+	std::vector<Mat> merges(settings.historyDepth + 1);
+	for (auto& merge : merges) {
+		merge.create(matImg.rows, matImg.cols, CV_8UC3);
+	}
+	FrameHistory history;
+	history.setCapacity(settings.historyDepth);
+	int mergeSlot = 0;
+	Mat matResult(matImg.rows, matImg.cols, CV_8UC3);
+	Mat matMask;
+	Mat matMaskPre;
+	MotionMap motion;
+	setMotionMap(&motion);
+	setFrameHistory(&history);
+	Frame frame;
+	while (decoded.pop(frame)) {
+		Mat& matMerge = merges[mergeSlot];
+		float intensity = mergeFrame(matMerge, matMask, motion, matMaskPre, matImg, frame.mat, settings.alphaCam, settings.maskScale);
+		setFrameSeed(deriveFrameSeed(baseSeed, frame.index));
+		effectChain.process(matResult, matMerge, intensity);
+
+		FrameHistory::Entry entry;
+		entry.merge = &matMerge;
+		entry.index = frame.index;
+		entry.slot = mergeSlot;
+		int evicted = history.push(entry);
+		mergeSlot = evicted >= 0 ? evicted : mergeSlot + 1;
+
+		recorder.push(matResult, frame.index);
+		rendered++;
+	}
+
+	reader.join();
+	recorder.stop();
+	uint64_t writeErrors = recorder.getStats().errors;
+	if (writeErrors > 0) {
+		std::cerr << writeErrors << " frames could not be written to " << settings.output << "\n";
+	}
+	setMotionMap(nullptr);
+	setFrameHistory(nullptr);
+	setPostprocessPool(nullptr);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "rendered " << rendered << " frames in " << seconds << "s ("
+		<< (seconds > 0 ? rendered / seconds : 0) << " fps)\n";
+	return writeErrors > 0 ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+//Headless offline renderer. Reads a video file or a numbered image sequence in place of the camera,
+//merges it with the background like ofApp::update() and writes the processed frames to disk.
+//No window, no GL context and no vsync, frames go through as fast as the pool allows.
+struct BatchRenderSettings {
+	//Video file, or printf style image sequence such as "in/frame_%05d.png".
+	std::string input;
+	//printf style image sequence such as "out/frame_%05d.png", or a .y4m or video file, see FrameRecorder.
+	std::string output;
+	std::string background = "cyber.png";
+	//One effect name or a comma separated chain.
+	std::string effect = "splitRGB1";
+	float alphaCam = 0.3f;
+	//The motion mask is computed at 1 / maskScale of the frame size.
+	int maskScale = 1;
+	//0 means hardware_concurrency.
+	unsigned threads = 0;
+	//Number of threads encoding image sequences, containers are written by one.
+	unsigned writers = 2;
+	int firstFrame = 0;
+	//-1 renders until the input runs out.
+	int maxFrames = -1;
+	//Earlier merged frames kept for timeScanLine and freezeBlock, as in the app.
+	int historyDepth = 4;
+	//Base of the per-frame seeds, picked at random without one.
+	bool hasSeed = false;
+	uint64_t seed = 0;
+};
+
+//Parses "--render" style arguments, returns false and prints usage on error.
+bool parseBatchRenderArgs(int argc, char* argv[], BatchRenderSettings& settings);
+
+//Returns a process exit code.
+int runBatchRender(const BatchRenderSettings& settings);
@@ -0,0 +1,360 @@
+#include "Benchmark.h"
+#include "Postprocess.h"
+#include "Blend.h"
+#include "EffectChain.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace cv;
+
+namespace {
+
+//Buffers one case works on. Two camera frames alternate so that the mask diff sees motion.
+struct BenchFrame {
+	Mat matImg;
+	Mat matCam[2];
+	Mat matMerge;
+	Mat matResult;
+	Mat matMask;
+	Mat matMaskPre;
+	MotionMap motion;
+	PlanarFrame planarMerge;
+	PlanarFrame planarResult;
+	//The camera frames stand in for earlier merges of the temporal effects.
+	FrameHistory history;
+	int iteration = 0;
+};
+
+struct BenchCase {
+	std::string name;
+	std::function<void(BenchFrame&, float)> run;
+};
+
+//--------------------------------------------------------------
+std::vector<BenchCase> getBenchCases() {
+	std::vector<BenchCase> cases;
+	cases.push_back({ "merge", [](BenchFrame& frame, float) {
+		mergeFrame(frame.matMerge, frame.matMask, frame.motion, frame.matMaskPre, frame.matImg, frame.matCam[frame.iteration & 1], 0.3f);
+	} });
+	//The mask alone: separate cvtColor, Otsu threshold and diff passes against the fused sweeps at full and half size.
+	cases.push_back({ "mask_separate", [](BenchFrame& frame, float) {
+		const Mat& cam = frame.matCam[frame.iteration & 1];
+		cvtColor(cam, frame.matMask, cv::COLOR_RGB2GRAY);
+		threshold(frame.matMask, frame.matMask, 0, 255, CV_THRESH_BINARY | CV_THRESH_OTSU);
+		if (frame.matMaskPre.rows != frame.matMask.rows || frame.matMaskPre.cols != frame.matMask.cols) {
+			frame.matMask.copyTo(frame.matMaskPre);
+		}
+		std::atomic<uint64> differentCount(0);
+		getPostprocessPool().parallelFor(0, frame.matMask.rows, 0, [&](int rowBegin, int rowEnd) {
+			for (uint64 j = uint64(rowBegin) * frame.matMask.cols; j < uint64(rowEnd) * frame.matMask.cols; j++) {
+				if (frame.matMask.data[j] != frame.matMaskPre.data[j]) {
+					differentCount++;
+					frame.matMaskPre.data[j] = frame.matMask.data[j];
+				}
+			}
+		});
+	} });
+	cases.push_back({ "mask", [](BenchFrame& frame, float) {
+		analyzeMask(frame.matMask, frame.motion, frame.matMaskPre, frame.matCam[frame.iteration & 1]);
+	} });
+	cases.push_back({ "mask_half", [](BenchFrame& frame, float) {
+		analyzeMask(frame.matMask, frame.motion, frame.matMaskPre, frame.matCam[frame.iteration & 1], 2);
+	} });
+	//The blend alone: the original float formula against every fixed-point path this CPU runs.
+	cases.push_back({ "blend_float", [](BenchFrame& frame, float) {
+		const Mat& cam = frame.matCam[frame.iteration & 1];
+		float alphaCam = 0.3f;
+		getPostprocessPool().parallelFor(0, frame.matImg.rows, 0, [&](int rowBegin, int rowEnd) {
+			for (uint64 j = uint64(rowBegin) * frame.matImg.cols * 3; j < uint64(rowEnd) * frame.matImg.cols * 3; j++) {
+				frame.matMerge.data[j] = frame.matImg.data[j] * (1 - alphaCam) + cam.data[j] * alphaCam;
+			}
+		});
+	} });
+	for (BlendPath path : { BLEND_SCALAR, BLEND_SSE2, BLEND_AVX2 }) {
+		BlendRowFunc blendRow = getBlendRow(path);
+		if (!blendRow) {
+			continue;
+		}
+		cases.push_back({ std::string("blend_") + getBlendPathName(path), [blendRow](BenchFrame& frame, float) {
+			const Mat& cam = frame.matCam[frame.iteration & 1];
+			int weight = blendWeight(0.3f);
+			getPostprocessPool().parallelFor(0, frame.matImg.rows, 0, [&](int rowBegin, int rowEnd) {
+				for (int row = rowBegin; row < rowEnd; row++) {
+					blendRow(frame.matMerge.ptr(row), frame.matImg.ptr(row), cam.ptr(row), frame.matImg.cols * 3, weight);
+				}
+			});
+		} });
+	}
+	for (auto& entry : getPostprocessList()) {
+		PostprocessFunc func = entry.func;
+		cases.push_back({ entry.name, [func](BenchFrame& frame, float intensity) {
+			func(frame.matResult, frame.matMerge, intensity);
+		} });
+	}
+	//Interleaved against planar layout for the effects that have both: the kernel alone, then the whole glitch
+	//stage, where planar also pays for splitting the pixels in the merge. The app uploads planes as they are,
+	//_frame_planar_interleaved adds the interleave a consumer of RGB frames would need.
+	for (auto& entry : getPostprocessList()) {
+		if (!entry.planar) {
+			continue;
+		}
+		PostprocessFunc func = entry.func;
+		PlanarPostprocessFunc planar = entry.planar;
+		cases.push_back({ std::string(entry.name) + "_planar", [planar](BenchFrame& frame, float intensity) {
+			planar(frame.planarResult, frame.planarMerge, intensity);
+		} });
+		cases.push_back({ std::string(entry.name) + "_frame", [func](BenchFrame& frame, float intensity) {
+			blendFrame(frame.matMerge, frame.matImg, frame.matCam[0], 0.3f);
+			func(frame.matResult, frame.matMerge, intensity);
+		} });
+		cases.push_back({ std::string(entry.name) + "_frame_planar", [planar](BenchFrame& frame, float intensity) {
+			blendFramePlanar(frame.planarMerge, frame.matImg, frame.matCam[0], 0.3f);
+			planar(frame.planarResult, frame.planarMerge, intensity);
+		} });
+		cases.push_back({ std::string(entry.name) + "_frame_planar_interleaved", [planar](BenchFrame& frame, float intensity) {
+			blendFramePlanar(frame.planarMerge, frame.matImg, frame.matCam[0], 0.3f);
+			planar(frame.planarResult, frame.planarMerge, intensity);
+			mergePlanes(frame.matResult, frame.planarResult);
+		} });
+	}
+	//Three row local stages fused in one pass against the same three run one after another.
+	cases.push_back({ "chain_fused", [](BenchFrame& frame, float intensity) {
+		static EffectChain effectChain;
+		if (effectChain.empty()) {
+			effectChain.append("scanLine");
+			effectChain.append("block1");
+			effectChain.append("digitalStripe");
+		}
+		effectChain.process(frame.matResult, frame.matMerge, intensity);
+	} });
+	cases.push_back({ "chain_unfused", [](BenchFrame& frame, float intensity) {
+		static Mat intermediate[2];
+		intermediate[0].create(frame.matMerge.rows, frame.matMerge.cols, CV_8UC3);
+		intermediate[1].create(frame.matMerge.rows, frame.matMerge.cols, CV_8UC3);
+		scanLine(intermediate[0], frame.matMerge, intensity);
+		block1(intermediate[1], intermediate[0], intensity);
+		digitalStripe(frame.matResult, intermediate[1], intensity);
+	} });
+	return cases;
+}
+
+//--------------------------------------------------------------
+template<class T>
+std::vector<T> parseList(const std::string& text, std::function<T(const std::string&)> parse) {
+	std::vector<T> values;
+	std::stringstream stream(text);
+	std::string item;
+	while (std::getline(stream, item, ',')) {
+		if (!item.empty()) {
+			values.push_back(parse(item));
+		}
+	}
+	return values;
+}
+
+//--------------------------------------------------------------
+void printUsage() {
+	std::cerr << "usage: InteractiveGlitchArtPostprocessing --bench [options]\n"
+		<< "  --sizes WxH,...     resolutions (default 640x480,1280x720,1920x1080,3840x2160)\n"
+		<< "  --threads n,...     pool sizes (default powers of two up to all cores)\n"
+		<< "  --intensity f,...   intensity values (default 0.1,0.5,1)\n"
+		<< "  --cases name,...    cases to run (default all)\n"
+		<< "  --warmup n          untimed iterations per case (default 3)\n"
+		<< "  --iterations n      timed iterations per case (default 30)\n"
+		<< "  --json              JSON lines instead of CSV\n"
+		<< "  --out file          write results to file instead of stdout\n"
+		<< "cases:";
+	for (auto& entry : getBenchCases()) {
+		std::cerr << " " << entry.name;
+	}
+	std::cerr << "\n";
+}
+
+}
+
+//--------------------------------------------------------------
+void fillSynthetic(Mat& mat, uint32_t seed, int boxX) {
+	uint32_t state = seed * 2654435761u + 1;
+	for (int y = 0; y < mat.rows; y++) {
+		uchar* row = mat.ptr(y);
+		for (int x = 0; x < mat.cols; x++) {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			bool inBox = boxX >= 0 && x >= boxX && x < boxX + mat.cols / 4 && y > mat.rows / 4;
+			row[x * 3] = inBox ? 230 : uchar(x * 255 / mat.cols) ^ (state & 15);
+			row[x * 3 + 1] = inBox ? 220 : uchar(y * 255 / mat.rows) ^ ((state >> 4) & 15);
+			row[x * 3 + 2] = inBox ? 210 : uchar((x + y) & 255) ^ ((state >> 8) & 15);
+		}
+	}
+}
+
+//--------------------------------------------------------------
+bool parseBenchmarkArgs(int argc, char* argv[], BenchmarkSettings& settings) {
+	//Option whose value is being parsed, named when std::sto* rejects the value.
+	std::string option;
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			option = arg;
+			bool hasValue = i + 1 < argc;
+			if (arg == "--bench") {
+				continue;
+			}
+			else if (arg == "--sizes" && hasValue) {
+				settings.sizes = parseList<std::pair<int, int>>(argv[++i], [](const std::string& item) {
+					size_t split = item.find('x');
+					return std::make_pair(std::stoi(item.substr(0, split)), std::stoi(item.substr(split + 1)));
+				});
+			}
+			else if (arg == "--threads" && hasValue) {
+				settings.threads = parseList<unsigned>(argv[++i], [](const std::string& item) { return unsigned(std::stoul(item)); });
+			}
+			else if (arg == "--intensity" && hasValue) {
+				settings.intensities = parseList<float>(argv[++i], [](const std::string& item) { return std::stof(item); });
+			}
+			else if (arg == "--cases" && hasValue) {
+				settings.cases = parseList<std::string>(argv[++i], [](const std::string& item) { return item; });
+			}
+			else if (arg == "--warmup" && hasValue) {
+				settings.warmup = std::max(0, std::stoi(argv[++i]));
+			}
+			else if (arg == "--iterations" && hasValue) {
+				settings.iterations = std::max(1, std::stoi(argv[++i]));
+			}
+			else if (arg == "--json") {
+				settings.json = true;
+			}
+			else if (arg == "--out" && hasValue) {
+				settings.output = argv[++i];
+			}
+			else {
+				std::cerr << "unknown option " << arg << "\n";
+				printUsage();
+				return false;
+			}
+		}
+	}
+	catch (const std::logic_error&) {
+		std::cerr << "invalid value for " << option << "\n";
+		printUsage();
+		return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+int runBenchmark(const BenchmarkSettings& settings) {
+
+	std::vector<BenchCase> cases;
+	for (auto& entry : getBenchCases()) {
+		if (settings.cases.empty() || std::find(settings.cases.begin(), settings.cases.end(), entry.name) != settings.cases.end()) {
+			cases.push_back(entry);
+		}
+	}
+	if (cases.empty()) {
+		std::cerr << "no matching cases\n";
+		printUsage();
+		return 1;
+	}
+
+	std::vector<unsigned> threadCounts = settings.threads;
+	if (threadCounts.empty()) {
+		unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned count = 1; count < hardware; count *= 2) {
+			threadCounts.push_back(count);
+		}
+		threadCounts.push_back(hardware);
+	}
+
+	std::ofstream file;
+	if (!settings.output.empty()) {
+		file.open(settings.output);
+		if (!file) {
+			std::cerr << "cannot write " << settings.output << "\n";
+			return 1;
+		}
+	}
+	std::ostream& out = settings.output.empty() ? std::cout : file;
+	if (!settings.json) {
+		out << "case,width,height,threads,intensity,iterations,mean_ms,p50_ms,p99_ms,ns_per_pixel,mpix_per_s\n";
+	}
+
+	for (auto& size : settings.sizes) {
+		BenchFrame frame;
+		frame.matImg.create(size.second, size.first, CV_8UC3);
+		frame.matCam[0].create(size.second, size.first, CV_8UC3);
+		frame.matCam[1].create(size.second, size.first, CV_8UC3);
+		frame.matMerge.create(size.second, size.first, CV_8UC3);
+		frame.matResult.create(size.second, size.first, CV_8UC3);
+		fillSynthetic(frame.matImg, 1, -1);
+		fillSynthetic(frame.matCam[0], 2, size.first / 4);
+		fillSynthetic(frame.matCam[1], 3, size.first / 2);
+		frame.history.setCapacity(2);
+		for (int i = 0; i < 2; i++) {
+			FrameHistory::Entry entry;
+			entry.merge = &frame.matCam[i];
+			entry.index = i;
+			frame.history.push(entry);
+		}
+		setFrameHistory(&frame.history);
+		double pixels = double(size.first) * size.second;
+
+		for (unsigned threads : threadCounts) {
+			ThreadPool threadPool(threads);
+			setPostprocessPool(&threadPool);
+			//Kernels read the merged frame, so build a realistic one first.
+			mergeFrame(frame.matMerge, frame.matMask, frame.motion, frame.matMaskPre, frame.matImg, frame.matCam[0], 0.3f);
+			splitPlanes(frame.planarMerge, frame.matMerge);
+
+			for (float intensity : settings.intensities) {
+				for (auto& entry : cases) {
+					setFrameSeed(1);
+					std::vector<double> samples;
+					for (int i = 0; i < settings.warmup + settings.iterations; i++) {
+						frame.iteration = i;
+						auto start = std::chrono::steady_clock::now();
+						entry.run(frame, intensity);
+						double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+						if (i >= settings.warmup) {
+							samples.push_back(seconds);
+						}
+					}
+
+					std::sort(samples.begin(), samples.end());
+					double mean = 0;
+					for (double sample : samples) {
+						mean += sample;
+					}
+					mean /= samples.size();
+					double p50 = samples[samples.size() / 2];
+					double p99 = samples[std::min(samples.size() - 1, size_t(samples.size() * 0.99))];
+					double nsPerPixel = mean * 1e9 / pixels;
+					double mpixPerSecond = pixels / mean * 1e-6;
+
+					if (settings.json) {
+						out << "{\"case\":\"" << entry.name << "\",\"width\":" << size.first << ",\"height\":" << size.second
+							<< ",\"threads\":" << threads << ",\"intensity\":" << intensity << ",\"iterations\":" << samples.size()
+							<< ",\"mean_ms\":" << mean * 1e3 << ",\"p50_ms\":" << p50 * 1e3 << ",\"p99_ms\":" << p99 * 1e3
+							<< ",\"ns_per_pixel\":" << nsPerPixel << ",\"mpix_per_s\":" << mpixPerSecond << "}\n";
+					}
+					else {
+						out << entry.name << "," << size.first << "," << size.second << "," << threads << "," << intensity << ","
+							<< samples.size() << "," << mean * 1e3 << "," << p50 * 1e3 << "," << p99 * 1e3 << ","
+							<< nsPerPixel << "," << mpixPerSecond << "\n";
+					}
+					out.flush();
+				}
+			}
+			setPostprocessPool(nullptr);
+		}
+	}
+	setFrameHistory(nullptr);
+	return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <string>
+#include <vector>
+
+//Micro-benchmark of the glitch kernels and the merge pass on synthetic frames, outside of the camera loop.
+//Every case is run for each resolution, thread count and intensity, results are written as CSV or JSON lines
+//so that runs of different builds can be diffed.
+struct BenchmarkSettings {
+	std::vector<std::pair<int, int>> sizes = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+	//Empty means 1, 2, 4 ... up to hardware_concurrency.
+	std::vector<unsigned> threads;
+	std::vector<float> intensities = { 0.1f, 0.5f, 1.0f };
+	//Case names to run, empty runs all of them.
+	std::vector<std::string> cases;
+	int warmup = 3;
+	int iterations = 30;
+	bool json = false;
+	//Empty writes to stdout.
+	std::string output;
+};
+
+//Parses "--bench" style arguments, returns false and prints usage on error.
+bool parseBenchmarkArgs(int argc, char* argv[], BenchmarkSettings& settings);
+
+//Returns a process exit code.
+int runBenchmark(const BenchmarkSettings& settings);
+
+//Deterministic gradient plus noise, with an optional bright box standing in for a person (boxX < 0 for none).
+//Also the input of the regression check, changing it invalidates the recorded golden frames.
+void fillSynthetic(cv::Mat& mat, uint32_t seed, int boxX);
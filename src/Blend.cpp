@@ -0,0 +1,205 @@
+#include "Blend.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BLEND_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//MSVC accepts AVX2 intrinsics in any function, GCC and clang need the target enabled per function.
+#if defined(BLEND_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BLEND_TARGET_AVX2 __attribute__((target("avx2")))
+#define BLEND_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define BLEND_TARGET_AVX2
+#define BLEND_TARGET_SSSE3
+#endif
+
+//Weights sum to 256, so img * (256 - w) + cam * w fits in 16 bits and the shift truncates like the float cast did.
+static inline uint8_t blendByte(uint8_t img, uint8_t cam, int weight) {
+	return uint8_t((img * (256 - weight) + cam * weight) >> 8);
+}
+
+//--------------------------------------------------------------
+static void blendRowScalar(uint8_t* out, const uint8_t* img, const uint8_t* cam, int count, int weight) {
+	for (int i = 0; i < count; i++) {
+		out[i] = blendByte(img[i], cam[i], weight);
+	}
+}
+
+//--------------------------------------------------------------
+static void blendPlanarRowScalar(uint8_t* red, uint8_t* green, uint8_t* blue, const uint8_t* img, const uint8_t* cam, int count, int weight) {
+	for (int i = 0; i < count; i++) {
+		red[i] = blendByte(img[i * 3], cam[i * 3], weight);
+		green[i] = blendByte(img[i * 3 + 1], cam[i * 3 + 1], weight);
+		blue[i] = blendByte(img[i * 3 + 2], cam[i * 3 + 2], weight);
+	}
+}
+
+#ifdef BLEND_X86
+//16 bytes at once, widened to 16 bit lanes.
+static inline __m128i blend16(__m128i a, __m128i b, __m128i imgWeight, __m128i camWeight) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), imgWeight), _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), camWeight));
+	__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), imgWeight), _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), camWeight));
+	return _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+}
+
+//16 bytes per step, widened to 16 bit lanes.
+static void blendRowSSE2(uint8_t* out, const uint8_t* img, const uint8_t* cam, int count, int weight) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i camWeight = _mm_set1_epi16(short(weight));
+	const __m128i imgWeight = _mm_set1_epi16(short(256 - weight));
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(img + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(cam + i));
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), imgWeight), _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), camWeight));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), imgWeight), _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), camWeight));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+	}
+	blendRowScalar(out + i, img + i, cam + i, count - i, weight);
+}
+
+//16 pixels per step. Byte i of plane channel is interleaved byte 3 * i + channel, spread over the three registers
+//of 16 bytes: one shuffle per register, indices with the high bit set give zero.
+BLEND_TARGET_SSSE3 static void blendPlanarRowSSSE3(uint8_t* red, uint8_t* green, uint8_t* blue, const uint8_t* img, const uint8_t* cam, int count, int weight) {
+	__m128i masks[3][3];
+	for (int channel = 0; channel < 3; channel++) {
+		for (int part = 0; part < 3; part++) {
+			alignas(16) char mask[16];
+			for (int i = 0; i < 16; i++) {
+				int index = 3 * i + channel - 16 * part;
+				mask[i] = index >= 0 && index < 16 ? char(index) : char(-1);
+			}
+			masks[channel][part] = _mm_load_si128((const __m128i*)mask);
+		}
+	}
+	const __m128i camWeight = _mm_set1_epi16(short(weight));
+	const __m128i imgWeight = _mm_set1_epi16(short(256 - weight));
+	uint8_t* planes[3] = { red, green, blue };
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i a[3];
+		__m128i b[3];
+		for (int part = 0; part < 3; part++) {
+			a[part] = _mm_loadu_si128((const __m128i*)(img + i * 3 + part * 16));
+			b[part] = _mm_loadu_si128((const __m128i*)(cam + i * 3 + part * 16));
+		}
+		for (int channel = 0; channel < 3; channel++) {
+			const __m128i* mask = masks[channel];
+			__m128i planeA = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a[0], mask[0]), _mm_shuffle_epi8(a[1], mask[1])), _mm_shuffle_epi8(a[2], mask[2]));
+			__m128i planeB = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(b[0], mask[0]), _mm_shuffle_epi8(b[1], mask[1])), _mm_shuffle_epi8(b[2], mask[2]));
+			_mm_storeu_si128((__m128i*)(planes[channel] + i), blend16(planeA, planeB, imgWeight, camWeight));
+		}
+	}
+	blendPlanarRowScalar(red + i, green + i, blue + i, img + i * 3, cam + i * 3, count - i, weight);
+}
+
+//32 bytes per step. Unpack and pack both work per 128 bit lane, so the byte order survives.
+BLEND_TARGET_AVX2 static void blendRowAVX2(uint8_t* out, const uint8_t* img, const uint8_t* cam, int count, int weight) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i camWeight = _mm256_set1_epi16(short(weight));
+	const __m256i imgWeight = _mm256_set1_epi16(short(256 - weight));
+	int i = 0;
+	for (; i + 32 <= count; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(img + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(cam + i));
+		__m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), imgWeight), _mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), camWeight));
+		__m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), imgWeight), _mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), camWeight));
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8)));
+	}
+	blendRowSSE2(out + i, img + i, cam + i, count - i, weight);
+}
+
+//--------------------------------------------------------------
+static bool cpuHasSSSE3() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 9)) != 0;
+#else
+	return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+//--------------------------------------------------------------
+static bool cpuHasAVX2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	//AVX2 also needs the OS to save the YMM registers.
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!osxsave || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+//--------------------------------------------------------------
+int blendWeight(float alpha) {
+	return std::min(256, std::max(0, int(alpha * 256 + 0.5f)));
+}
+
+//--------------------------------------------------------------
+BlendRowFunc getBlendRow(BlendPath path) {
+	switch (path) {
+	case BLEND_SCALAR:
+		return blendRowScalar;
+#ifdef BLEND_X86
+	case BLEND_SSE2:
+		return blendRowSSE2;
+	case BLEND_AVX2:
+		return cpuHasAVX2() ? blendRowAVX2 : nullptr;
+#endif
+	default:
+		return nullptr;
+	}
+}
+
+//--------------------------------------------------------------
+BlendPath getBestBlendPath() {
+	static const BlendPath best = getBlendRow(BLEND_AVX2) ? BLEND_AVX2 : getBlendRow(BLEND_SSE2) ? BLEND_SSE2 : BLEND_SCALAR;
+	return best;
+}
+
+//--------------------------------------------------------------
+BlendRowFunc getBestBlendRow() {
+	static const BlendRowFunc best = getBlendRow(getBestBlendPath());
+	return best;
+}
+
+//--------------------------------------------------------------
+BlendPlanarRowFunc getBestBlendPlanarRow() {
+#ifdef BLEND_X86
+	static const BlendPlanarRowFunc best = cpuHasSSSE3() ? blendPlanarRowSSSE3 : blendPlanarRowScalar;
+#else
+	static const BlendPlanarRowFunc best = blendPlanarRowScalar;
+#endif
+	return best;
+}
+
+//--------------------------------------------------------------
+const char* getBlendPathName(BlendPath path) {
+	switch (path) {
+	case BLEND_SSE2:
+		return "sse2";
+	case BLEND_AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
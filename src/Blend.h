@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+//Background/camera blend of one run of interleaved bytes: out = img * (1 - alpha) + cam * alpha.
+//alpha is turned into an 8 bit fixed-point weight once per frame, the result is within 1 LSB of the float formula.
+typedef void (*BlendRowFunc)(uint8_t* out, const uint8_t* img, const uint8_t* cam, int count, int weight);
+
+//Same blend of count interleaved pixels written as three planes: red[i], green[i], blue[i] of pixel i.
+typedef void (*BlendPlanarRowFunc)(uint8_t* red, uint8_t* green, uint8_t* blue, const uint8_t* img, const uint8_t* cam, int count, int weight);
+
+enum BlendPath {
+	BLEND_SCALAR,
+	BLEND_SSE2,
+	BLEND_AVX2,
+};
+
+//alpha in [0, 1] to a weight in [0, 256].
+int blendWeight(float alpha);
+
+//nullptr when the CPU or the compiler cannot run that path.
+BlendRowFunc getBlendRow(BlendPath path);
+
+//Widest path the CPU supports, picked once at run time.
+BlendRowFunc getBestBlendRow();
+BlendPath getBestBlendPath();
+
+//Scalar, or SSSE3 byte shuffles that split the pixels into planes in registers before the SSE2 blend.
+BlendPlanarRowFunc getBestBlendPlanarRow();
+
+const char* getBlendPathName(BlendPath path);
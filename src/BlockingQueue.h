@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+//Bounded blocking queue between threads of a pipeline. A full queue holds back the producer,
+//so a slow consumer never lets frames pile up in RAM. Items live in a ring allocated once.
+template<class T>
+class BlockingQueue {
+
+	public:
+		explicit BlockingQueue(size_t capacity) : items(std::max<size_t>(1, capacity)) {}
+
+		void push(T value) {
+			std::unique_lock<std::mutex> lock(mutex);
+			notFull.wait(lock, [this] { return count < items.size(); });
+			items[(head + count) % items.size()] = std::move(value);
+			count++;
+			notEmpty.notify_one();
+		}
+
+		//Returns false once the queue is closed and drained.
+		bool pop(T& value) {
+			std::unique_lock<std::mutex> lock(mutex);
+			notEmpty.wait(lock, [this] { return closed || count > 0; });
+			if (count == 0) {
+				return false;
+			}
+			value = std::move(items[head]);
+			head = (head + 1) % items.size();
+			count--;
+			notFull.notify_one();
+			return true;
+		}
+
+		void close() {
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+			notEmpty.notify_all();
+		}
+
+	private:
+		std::vector<T> items;
+		size_t head = 0;
+		size_t count = 0;
+		std::mutex mutex;
+		std::condition_variable notEmpty;
+		std::condition_variable notFull;
+		bool closed = false;
+};
@@ -0,0 +1,28 @@
+#include "DataPath.h"
+
+#ifndef GLITCH_HEADLESS
+#include "ofMain.h"
+#elif !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------
+std::string getDataPath(const std::string& name) {
+#ifndef GLITCH_HEADLESS
+	return ofToDataPath(name);
+#else
+	if (name.empty() || name[0] == '/' || name[0] == '\\' || name.find(':') != std::string::npos) {
+		return name;
+	}
+	std::string folder = "data/";
+#ifndef _WIN32
+	char executable[4096];
+	ssize_t length = readlink("/proc/self/exe", executable, sizeof(executable) - 1);
+	if (length > 0) {
+		std::string path(executable, size_t(length));
+		folder = path.substr(0, path.find_last_of('/') + 1) + folder;
+	}
+#endif
+	return folder + name;
+#endif
+}
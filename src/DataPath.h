@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+//Relative names are looked up in the data folder next to the executable, like ofToDataPath, so the headless modes
+//find their files from any working directory. Absolute paths pass through.
+std::string getDataPath(const std::string& name);
@@ -0,0 +1,167 @@
+#include "EffectChain.h"
+#include "GlitchRandom.h"
+#include "Profiler.h"
+
+using namespace cv;
+
+//--------------------------------------------------------------
+bool EffectChain::append(const std::string& name) {
+	return append(findPostprocessEntry(name));
+}
+
+//--------------------------------------------------------------
+bool EffectChain::append(PostprocessFunc func) {
+	return append(findPostprocessEntry(func));
+}
+
+//--------------------------------------------------------------
+bool EffectChain::append(const PostprocessEntry* entry) {
+	if (!entry) {
+		return false;
+	}
+	stages.push_back(entry->createStage());
+	names.push_back(entry->name);
+	return true;
+}
+
+//--------------------------------------------------------------
+void EffectChain::clear() {
+	stages.clear();
+	names.clear();
+}
+
+//--------------------------------------------------------------
+std::string EffectChain::describe() const {
+	std::string text;
+	for (auto& name : names) {
+		text += (text.empty() ? "" : " > ") + name;
+	}
+	return text;
+}
+
+//--------------------------------------------------------------
+void EffectChain::process(Mat& OutResult, const Mat& InMat, float intensity) {
+	PROFILE_SCOPE("effect chain");
+	if (stages.empty()) {
+		InMat.copyTo(OutResult);
+		return;
+	}
+
+	prepare(InMat.rows, InMat.cols, intensity);
+
+	//Runs of row local stages are fused, any other stage runs alone on a full frame.
+	const Mat* source = &InMat;
+	int ping = 0;
+	size_t first = 0;
+	while (first < stages.size()) {
+		size_t last = first + 1;
+		if (stages[first]->isRowLocal()) {
+			while (last < stages.size() && stages[last]->isRowLocal()) {
+				last++;
+			}
+		}
+
+		Mat* target = &OutResult;
+		if (last < stages.size()) {
+			intermediate[ping].create(InMat.rows, InMat.cols, CV_8UC3);
+			target = &intermediate[ping];
+			ping ^= 1;
+		}
+
+		if (last - first > 1) {
+			processFused(first, last, *target, *source);
+		}
+		else {
+			stages[first]->processFrame(*target, *source);
+		}
+		source = target;
+		first = last;
+	}
+}
+
+//--------------------------------------------------------------
+void EffectChain::prepare(int rows, int cols, float intensity) {
+	frameRows = rows;
+	if (stages.size() > 1) {
+		ThreadPool& threadPool = getPostprocessPool();
+		size_t bandBytes = size_t(getBandRows(rows, cols)) * cols * 3;
+		scratchBandBytes = std::max(scratchBandBytes, bandBytes);
+		size_t scratchBytes = scratchBandBytes * 2 * threadPool.getSlotCount();
+		if (scratch.size() < scratchBytes) {
+			scratch.resize(scratchBytes);
+		}
+	}
+	for (size_t i = 0; i < stages.size(); i++) {
+		stages[i]->prepare(rows, cols, intensity, i == 0 ? getFrameSeed() : deriveFrameSeed(getFrameSeed(), i));
+	}
+}
+
+//--------------------------------------------------------------
+int EffectChain::getRowReach() const {
+	int reach = 0;
+	for (auto& stage : stages) {
+		reach += stage->getRowReach();
+	}
+	return reach;
+}
+
+//Each stage writes the rows the stages after it still read, so the window shrinks by the stage's reach on each side
+//until the last stage writes the strip alone. Stages alternate between the window and a scratch window.
+void EffectChain::processStrip(Mat& OutStrip, Mat& InOutWindow, int rowBegin, int rowEnd) {
+	PROFILE_SCOPE("effect chain strip");
+	int reach = getRowReach();
+	if (stages.empty()) {
+		Mat(rowEnd - rowBegin, InOutWindow.cols, CV_8UC3, InOutWindow.ptr(reach)).copyTo(OutStrip);
+		return;
+	}
+	if (stages.size() > 1) {
+		intermediate[0].create(InOutWindow.rows, InOutWindow.cols, CV_8UC3);
+	}
+
+	Mat* source = &InOutWindow;
+	Mat* target = &intermediate[0];
+	int sourceBegin = rowBegin - reach;
+	for (size_t i = 0; i < stages.size(); i++) {
+		reach -= stages[i]->getRowReach();
+		if (i == stages.size() - 1) {
+			target = &OutStrip;
+		}
+		stages[i]->processStrip(*target, *source, sourceBegin, rowBegin - reach, rowEnd + reach, frameRows);
+		sourceBegin = rowBegin - reach;
+		std::swap(source, target);
+	}
+}
+
+//Input rows plus the two scratch bands should fit in tileBytes, and each thread should get a few bands to steal from.
+int EffectChain::getBandRows(int rows, int cols) const {
+	size_t rowBytes = size_t(cols) * 3;
+	int bandRows = int(std::max<size_t>(1, tileBytes / (rowBytes * 3)));
+	return std::min(bandRows, std::max(1, rows / int(getPostprocessPool().size() * 4)));
+}
+
+//Every band goes through stages [first, last) in a pair of scratch bands, only the final stage writes OutResult.
+void EffectChain::processFused(size_t first, size_t last, Mat& OutResult, const Mat& InMat) {
+	PROFILE_SCOPE("fused stages");
+	ThreadPool& threadPool = getPostprocessPool();
+	size_t rowBytes = size_t(InMat.cols) * 3;
+	int grain = getBandRows(InMat.rows, InMat.cols);
+
+	threadPool.parallelFor(0, InMat.rows, grain, [&](int rowBegin, int rowEnd) {
+		//Pair of band buffers of the slot running the task, a worker or any caller helping out.
+		uchar* bytes = scratch.data() + ThreadPool::getTaskSlot() * scratchBandBytes * 2;
+
+		for (int bandBegin = rowBegin; bandBegin < rowEnd; bandBegin += grain) {
+			int bandEnd = std::min(rowEnd, bandBegin + grain);
+			for (size_t stage = first; stage < last; stage++) {
+				uchar* read = bytes + ((stage - first + 1) & 1) * scratchBandBytes;
+				uchar* write = bytes + ((stage - first) & 1) * scratchBandBytes;
+				for (int row = bandBegin; row < bandEnd; row++) {
+					size_t offset = size_t(row - bandBegin) * rowBytes;
+					const uchar* in = stage == first ? InMat.ptr(row) : read + offset;
+					uchar* out = stage == last - 1 ? OutResult.ptr(row) : write + offset;
+					stages[stage]->processRow(out, in, row);
+				}
+			}
+		}
+	});
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Postprocess.h"
+
+//Several postprocesses applied in order, e.g. scanLine -> splitRGB2 -> digitalStripe.
+//Consecutive row local stages are fused: each band of rows small enough to stay in cache goes through all of them
+//before it is written out, so they cost one pass over the frame together. A stage that needs non local reads
+//(splitRGB2, sand) ends the fused run, its input is materialized as a full frame intermediate.
+class EffectChain {
+
+	public:
+		//False for unknown effects.
+		bool append(const std::string& name);
+		bool append(PostprocessFunc func);
+		void clear();
+		bool empty() const { return stages.empty(); }
+		size_t size() const { return stages.size(); }
+
+		//"scanLine > splitRGB2 > digitalStripe"
+		std::string describe() const;
+
+		//Upper bound on the bytes of one fused band, input rows included.
+		void setTileBytes(size_t bytes) { tileBytes = bytes; }
+
+		//Same contract as a PostprocessFunc. The first stage uses the frame seed, later ones derive their own,
+		//so an effect used twice does not repeat its noise.
+		void process(cv::Mat& OutResult, const cv::Mat& InMat, float intensity);
+
+		//Strip by strip processing of a frame too large to hold, see StillRenderer. prepare() once with the size of the
+		//whole frame and the frame seed set, then processStrip() for each strip, in any order. Same output as process().
+		void prepare(int rows, int cols, float intensity);
+		//Rows above and below a strip its input window must hold, the sum of the stages' reaches.
+		int getRowReach() const;
+		//OutStrip = rows [rowBegin, rowEnd) of the result. InOutWindow holds rows
+		//[rowBegin - getRowReach(), rowEnd + getRowReach()) of the input, wrapped around at the edges, and is
+		//overwritten. OutStrip must not share memory with it.
+		void processStrip(cv::Mat& OutStrip, cv::Mat& InOutWindow, int rowBegin, int rowEnd);
+
+	private:
+		bool append(const PostprocessEntry* entry);
+		void processFused(size_t first, size_t last, cv::Mat& OutResult, const cv::Mat& InMat);
+		//Rows of one fused band of a frame cols wide with rows rows.
+		int getBandRows(int rows, int cols) const;
+
+		std::vector<std::unique_ptr<GlitchStage>> stages;
+		std::vector<std::string> names;
+		cv::Mat intermediate[2];
+		//A pair of band buffers per pool slot, sized by prepare() for the largest frame so far so that no band allocates.
+		std::vector<uchar> scratch;
+		size_t scratchBandBytes = 0;
+		//Rows of the frame prepare() was called with.
+		int frameRows = 0;
+		size_t tileBytes = 256 * 1024;
+};
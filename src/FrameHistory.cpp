@@ -0,0 +1,59 @@
+#include "FrameHistory.h"
+
+#include <algorithm>
+
+using namespace cv;
+
+//--------------------------------------------------------------
+void FrameHistory::setCapacity(int frames) {
+	entries.assign(std::max(0, frames), Entry());
+	newest = -1;
+	count = 0;
+}
+
+//--------------------------------------------------------------
+const FrameHistory::Entry* FrameHistory::get(int age) const {
+	if (age < 1 || age > count) {
+		return nullptr;
+	}
+	int size = capacity();
+	return &entries[(newest - (age - 1) + size) % size];
+}
+
+//--------------------------------------------------------------
+const Mat* FrameHistory::getMerge(int age, int rows, int cols) const {
+	const Entry* entry = get(age);
+	if (!entry || !entry->merge || entry->merge->rows != rows || entry->merge->cols != cols) {
+		return nullptr;
+	}
+	return entry->merge;
+}
+
+//--------------------------------------------------------------
+int FrameHistory::push(const Entry& entry) {
+	int size = capacity();
+	if (size == 0) {
+		return entry.slot;
+	}
+	int evicted = -1;
+	if (count == size) {
+		evicted = popOldest();
+	}
+	newest = (newest + 1) % size;
+	entries[newest] = entry;
+	count++;
+	return evicted;
+}
+
+//--------------------------------------------------------------
+int FrameHistory::popOldest() {
+	if (count == 0) {
+		return -1;
+	}
+	int size = capacity();
+	Entry& oldest = entries[(newest - (count - 1) + size) % size];
+	int slot = oldest.slot;
+	oldest = Entry();
+	count--;
+	return slot;
+}
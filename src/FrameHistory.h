@@ -0,0 +1,44 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdint>
+#include <vector>
+
+//The merged frames before the one being processed, newest first, for effects that reach back in time (datamosh,
+//slit scan). Entries point at frames where they already live, a FramePool slot in the app, nothing is copied.
+//Whoever fills the history must leave a frame's buffers alone until its slot comes back from push() or popOldest().
+//Fixed capacity: nothing is allocated after setCapacity().
+class FrameHistory {
+
+	public:
+		struct Entry {
+			const cv::Mat* merge = nullptr;
+			uint64_t index = 0;
+			//Owner's handle of the frame, handed back when the entry leaves the history.
+			int slot = -1;
+		};
+
+		//Drops every entry, pop them first to get their slots back.
+		void setCapacity(int frames);
+		int capacity() const { return int(entries.size()); }
+		int size() const { return count; }
+
+		//age 1 is the newest entry, nullptr past the oldest one.
+		const Entry* get(int age) const;
+		//Merged frame age frames back, nullptr past the oldest entry or when that frame has another size
+		//(adaptive resolution).
+		const cv::Mat* getMerge(int age, int rows, int cols) const;
+
+		//Adds the newest frame. Returns the slot of the oldest entry when it had to make room, -1 otherwise.
+		//With capacity 0 the entry itself comes back.
+		int push(const Entry& entry);
+		//Removes the oldest entry and returns its slot, -1 when empty.
+		int popOldest();
+
+	private:
+		std::vector<Entry> entries;
+		//Position of the newest entry.
+		int newest = -1;
+		int count = 0;
+};
@@ -0,0 +1,385 @@
+#include "FramePipeline.h"
+#include "AllocationCounter.h"
+#include "Profiler.h"
+
+#include <cassert>
+
+using namespace cv;
+
+//Every markReconfigured() of any pipeline, see glitchLoop.
+static std::atomic<uint64_t> reconfigurationCount{ 0 };
+
+//--------------------------------------------------------------
+FramePipeline::~FramePipeline() {
+	stop();
+}
+
+//--------------------------------------------------------------
+void FramePipeline::setup(FramePool& pool, const Mat& InImg, GlitchFunc glitch, int slots) {
+	stop();
+	matImg = InImg;
+	matMaskPre.release();
+	backgrounds.clear();
+	this->glitch = glitch;
+	this->pool = &pool;
+	this->slots = slots;
+	pool.allocate(matImg.rows, matImg.cols, slots + historyDepth);
+
+	freeSlots.clear();
+	doneSlots.clear();
+	freeSlots.reserve(pool.size());
+	doneSlots.reserve(slots);
+	slotReferences.assign(pool.size(), 0);
+	history.setCapacity(historyDepth);
+	historyFrames = 0;
+	inFlight = 0;
+	for (int i = 0; i < pool.size(); i++) {
+		freeSlots.push_back(i);
+	}
+	maxInFlight = std::min(maxInFlight, slots);
+	steadyFrames = 0;
+	for (auto& nanos : stageNanos) {
+		nanos = 0;
+	}
+
+	//Each queue can hold every slot, so pushing never blocks.
+	analyzeQueue.reset(new BlockingQueue<int>(slots));
+	glitchQueue.reset(new BlockingQueue<int>(slots));
+	analyzeThread = std::thread(&FramePipeline::analyzeLoop, this);
+	glitchThread = std::thread(&FramePipeline::glitchLoop, this);
+}
+
+//--------------------------------------------------------------
+void FramePipeline::stop() {
+	if (analyzeQueue) {
+		analyzeQueue->close();
+	}
+	if (analyzeThread.joinable()) {
+		analyzeThread.join();
+	}
+	if (glitchQueue) {
+		glitchQueue->close();
+	}
+	if (glitchThread.joinable()) {
+		glitchThread.join();
+	}
+	analyzeQueue.reset();
+	glitchQueue.reset();
+}
+
+//--------------------------------------------------------------
+void FramePipeline::setMaxInFlight(int frames) {
+	std::lock_guard<std::mutex> lock(slotMutex);
+	maxInFlight = std::max(1, std::min(frames, getSlotCount()));
+}
+
+//--------------------------------------------------------------
+size_t FramePipeline::getHistoryBytes() const {
+	if (!pool || pool->size() == 0) {
+		return 0;
+	}
+	return pool->getBytes() / pool->size() * historyDepth;
+}
+
+//--------------------------------------------------------------
+void FramePipeline::setAdaptiveResolution(bool enabled) {
+	std::lock_guard<std::mutex> lock(statsMutex);
+	scaler.setEnabled(enabled);
+	scaleLevel = scaler.getLevel();
+}
+
+//--------------------------------------------------------------
+void FramePipeline::setFrameBudgetMs(double ms) {
+	std::lock_guard<std::mutex> lock(statsMutex);
+	scaler.setBudgetMs(ms);
+}
+
+//--------------------------------------------------------------
+void FramePipeline::markReconfigured() {
+	reconfigurationCount++;
+}
+
+//--------------------------------------------------------------
+bool FramePipeline::submit(const Mat& InCam, float alphaCam) {
+	PROFILE_SCOPE("capture");
+	auto start = Clock::now();
+	int slot;
+	{
+		std::lock_guard<std::mutex> lock(slotMutex);
+		if (freeSlots.empty() || inFlight >= maxInFlight) {
+			std::lock_guard<std::mutex> statsLock(statsMutex);
+			dropped++;
+			return false;
+		}
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+		slotReferences[slot] = 1;
+		inFlight++;
+	}
+
+	Frame& frame = pool->get(slot);
+	float scale = ResolutionScaler::getLevelScale(scaleLevel);
+	int rows = std::max(1, int(pool->getRows() * scale + 0.5f));
+	int cols = std::max(1, int(pool->getCols() * scale + 0.5f));
+	FramePool::setSize(frame, rows, cols, maskScale);
+
+	//Cameras do not always deliver the size asked for, and the processing size may be smaller.
+	if (InCam.rows == rows && InCam.cols == cols) {
+		InCam.copyTo(frame.matCam);
+	}
+	else {
+		resize(InCam, frame.matCam, frame.matCam.size(), 0, 0, INTER_AREA);
+	}
+	frame.alphaCam = alphaCam;
+	frame.index = nextIndex++;
+	frame.captured = start;
+	record(FramePool::STAGE_CAPTURE, frame, start);
+	analyzeQueue->push(slot);
+	return true;
+}
+
+//--------------------------------------------------------------
+FramePipeline::Frame* FramePipeline::acquireLatest() {
+	std::lock_guard<std::mutex> lock(slotMutex);
+	if (doneSlots.empty()) {
+		return nullptr;
+	}
+	//Older finished frames would only add latency.
+	while (doneSlots.size() > 1) {
+		recycle(doneSlots.front());
+		doneSlots.erase(doneSlots.begin());
+		std::lock_guard<std::mutex> statsLock(statsMutex);
+		dropped++;
+	}
+	Frame* frame = &pool->get(doneSlots.front());
+	doneSlots.erase(doneSlots.begin());
+	frame->presentStart = Clock::now();
+	return frame;
+}
+
+//--------------------------------------------------------------
+void FramePipeline::release(Frame* frame) {
+	auto end = Clock::now();
+	record(FramePool::STAGE_PRESENT, *frame, frame->presentStart);
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+		latencyStats.add(std::chrono::duration<double>(end - frame->captured).count());
+		presented++;
+	}
+	int slot = pool->indexOf(frame);
+	if (slot >= 0) {
+		std::lock_guard<std::mutex> lock(slotMutex);
+		recycle(slot);
+	}
+}
+
+//--------------------------------------------------------------
+FramePipeline::Stats FramePipeline::getStats() const {
+	std::lock_guard<std::mutex> lock(statsMutex);
+	Stats stats;
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		stats.stages[i].meanMs = stageStats[i].mean() * 1e3;
+		stats.stages[i].p99Ms = stageStats[i].percentile(0.99) * 1e3;
+	}
+	stats.latency.meanMs = latencyStats.mean() * 1e3;
+	stats.latency.p99Ms = latencyStats.percentile(0.99) * 1e3;
+	stats.presented = presented;
+	stats.dropped = dropped;
+	stats.allocations = allocations;
+	stats.rows = rows;
+	stats.cols = cols;
+	stats.urgent = urgent;
+	stats.missed = missed;
+	stats.historyFrames = historyFrames;
+	stats.historyBytes = getHistoryBytes();
+	return stats;
+}
+
+//--------------------------------------------------------------
+const char* FramePipeline::getStageName(Stage stage) {
+	switch (stage) {
+	case FramePool::STAGE_CAPTURE:
+		return "capture";
+	case FramePool::STAGE_ANALYZE:
+		return "analyze";
+	case FramePool::STAGE_GLITCH:
+		return "glitch";
+	case FramePool::STAGE_PRESENT:
+		return "present";
+	default:
+		return "";
+	}
+}
+
+//Frames reach this thread in capture order, which the mask diff relies on.
+void FramePipeline::analyzeLoop() {
+	setProfileThreadName(name.empty() ? "analyze" : "analyze " + name);
+	countAllocations(true);
+	int slot;
+	while (analyzeQueue->pop(slot)) {
+		PROFILE_SCOPE("analyze");
+		auto start = Clock::now();
+		Frame& frame = pool->get(slot);
+		ThreadPool::setThreadLevel(getFrameLevel(frame, FramePool::STAGE_ANALYZE));
+		frame.intensity = analyzeMask(frame.matMask, frame.motion, matMaskPre, frame.matCam, frame.maskScale);
+		record(FramePool::STAGE_ANALYZE, frame, start);
+		glitchQueue->push(slot);
+	}
+	glitchQueue->close();
+}
+
+//--------------------------------------------------------------
+void FramePipeline::glitchLoop() {
+	setProfileThreadName(name.empty() ? "glitch" : "glitch " + name);
+	countAllocations(true);
+	allocationsBefore = getAllocationCount();
+	reconfigurations = reconfigurationCount;
+	int slot;
+	while (glitchQueue->pop(slot)) {
+		PROFILE_SCOPE("glitch");
+		auto start = Clock::now();
+		Frame& frame = pool->get(slot);
+		ThreadPool::Level level = getFrameLevel(frame, FramePool::STAGE_GLITCH);
+		ThreadPool::setThreadLevel(level);
+		const Mat& background = getBackground(frame.matCam.rows, frame.matCam.cols);
+		setMotionMap(&frame.motion);
+		setFrameHistory(&history);
+		setPixelScale(float(frame.matCam.cols) / float(matImg.cols));
+		frame.planar = false;
+		if (planar && planarGlitch) {
+			blendFramePlanar(frame.planarMerge, background, frame.matCam, frame.alphaCam);
+			frame.planar = planarGlitch(frame.planarResult, frame.planarMerge, frame.intensity, frame.index);
+			if (!frame.planar) {
+				mergePlanes(frame.matMerge, frame.planarMerge);
+				glitch(frame.matResult, frame.matMerge, frame.intensity, frame.index);
+			}
+		}
+		else {
+			blendFrame(frame.matMerge, background, frame.matCam, frame.alphaCam);
+			glitch(frame.matResult, frame.matMerge, frame.intensity, frame.index);
+		}
+		record(FramePool::STAGE_GLITCH, frame, start);
+		bool late = deadlineNanos > 0 && Clock::now() - frame.captured > std::chrono::nanoseconds(deadlineNanos);
+
+		//Overlapped stages only need the slower one to fit, a single frame in flight needs both.
+		double analyzeMs = frame.stageSeconds[FramePool::STAGE_ANALYZE] * 1e3;
+		double glitchMs = frame.stageSeconds[FramePool::STAGE_GLITCH] * 1e3;
+		double frameMs = maxInFlight > 1 ? std::max(analyzeMs, glitchMs) : analyzeMs + glitchMs;
+		{
+			std::lock_guard<std::mutex> lock(statsMutex);
+			rows = frame.matCam.rows;
+			cols = frame.matCam.cols;
+			urgent += level == ThreadPool::LEVEL_URGENT;
+			missed += late;
+			if (scaler.addFrame(frameMs)) {
+				scaleLevel = scaler.getLevel();
+				//The new size allocates its background and previous mask once.
+				markReconfigured();
+			}
+		}
+
+		//Everything both threads and the pool allocated since the previous frame. Once the settings
+		//stopped changing there must be nothing, see FramePool.
+		uint64_t allocationsNow = getAllocationCount();
+		uint64_t frameAllocations = allocationsNow - allocationsBefore;
+		allocationsBefore = allocationsNow;
+		{
+			std::lock_guard<std::mutex> lock(statsMutex);
+			allocations = frameAllocations;
+		}
+		uint64_t reconfigurationsNow = reconfigurationCount;
+		if (reconfigurationsNow != reconfigurations) {
+			reconfigurations = reconfigurationsNow;
+			steadyFrames = 0;
+		}
+		if (steadyFrames < warmupFrames) {
+			steadyFrames++;
+		}
+		else {
+			assert(frameAllocations == 0);
+		}
+
+		pushHistory(slot);
+	}
+}
+
+//Caller holds slotMutex.
+void FramePipeline::recycle(int slot) {
+	unreference(slot);
+	inFlight--;
+}
+
+//Caller holds slotMutex.
+void FramePipeline::unreference(int slot) {
+	if (--slotReferences[slot] == 0) {
+		freeSlots.push_back(slot);
+	}
+}
+
+//The frame is kept by reference, its slot only goes back to freeSlots once it left the history too.
+void FramePipeline::pushHistory(int slot) {
+	Frame& frame = pool->get(slot);
+	{
+		std::lock_guard<std::mutex> lock(slotMutex);
+		if (frame.planar) {
+			//The planar path leaves matMerge as it was, the frames before it would stay in the history for good.
+			for (int evicted = history.popOldest(); evicted >= 0; evicted = history.popOldest()) {
+				unreference(evicted);
+			}
+		}
+		else if (history.capacity() > 0) {
+			FrameHistory::Entry entry;
+			entry.merge = &frame.matMerge;
+			entry.index = frame.index;
+			entry.slot = slot;
+			slotReferences[slot]++;
+			int evicted = history.push(entry);
+			if (evicted >= 0) {
+				unreference(evicted);
+			}
+		}
+		doneSlots.push_back(slot);
+	}
+	std::lock_guard<std::mutex> lock(statsMutex);
+	historyFrames = history.size();
+}
+
+//Background at the processing size, scaled once per size.
+const Mat& FramePipeline::getBackground(int rows, int cols) {
+	if (matImg.rows == rows && matImg.cols == cols) {
+		return matImg;
+	}
+	for (auto& background : backgrounds) {
+		if (background.rows == rows && background.cols == cols) {
+			return background;
+		}
+	}
+	backgrounds.emplace_back();
+	resize(matImg, backgrounds.back(), Size(cols, rows), 0, 0, INTER_AREA);
+	return backgrounds.back();
+}
+
+//--------------------------------------------------------------
+void FramePipeline::record(Stage stage, Frame& frame, Clock::time_point start) {
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	frame.stageSeconds[stage] = seconds;
+	stageNanos[stage] = int64_t(seconds * 1e9);
+	std::lock_guard<std::mutex> lock(statsMutex);
+	stageStats[stage].add(seconds);
+}
+
+//Urgent once the time since capture plus the last times of the stages still ahead (this one included) passes the deadline.
+ThreadPool::Level FramePipeline::getFrameLevel(const Frame& frame, Stage stage) const {
+	int64_t deadline = deadlineNanos;
+	if (deadline > 0) {
+		int64_t ahead = 0;
+		for (int i = stage; i <= FramePool::STAGE_GLITCH; i++) {
+			ahead += stageNanos[i];
+		}
+		int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - frame.captured).count();
+		if (elapsed + ahead > deadline) {
+			return ThreadPool::LEVEL_URGENT;
+		}
+	}
+	return priority;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "Postprocess.h"
+#include "FramePool.h"
+#include "FrameHistory.h"
+#include "BlockingQueue.h"
+#include "RollingStats.h"
+#include "ResolutionScaler.h"
+
+#include <functional>
+
+//Camera frames go through capture -> analyze -> glitch -> present, each stage working on a different frame.
+//Capture and present stay on the main thread (grabber and GL), analyze (gray, Otsu, mask diff) and
+//glitch (blend and postprocess) have a thread each and both use the shared pool.
+//Frames live in the slots of a FramePool, three by default, so buffers are reused and nothing queues up unbounded.
+//maxInFlight trades latency for throughput: 1 runs one frame at a time, the slot count overlaps all stages.
+//With adaptive resolution on, frames are processed at the size that keeps analyze + glitch within a time budget
+//and the result is smaller than the background, the caller scales it up for display.
+//Several pipelines (streams) may share the postprocess pool. Each one queues its passes at its priority, and at
+//ThreadPool::LEVEL_URGENT while a frame is about to miss its deadline.
+//With a history depth the merged frames of the last few glitched frames stay in their slots for the temporal effects
+//(see FrameHistory): the pool gets that many slots more, and a slot is free again once it is neither in flight nor
+//in the history.
+class FramePipeline {
+
+	public:
+		typedef FramePool::Clock Clock;
+		typedef FramePool::Stage Stage;
+		typedef FramePool::Frame Frame;
+		static const int STAGE_COUNT = FramePool::STAGE_COUNT;
+
+		//Runs on the glitch thread: postprocess of one merged frame.
+		typedef std::function<void(cv::Mat& OutResult, const cv::Mat& InMerge, float intensity, uint64_t frameIndex)> GlitchFunc;
+		//Same on planes, returns false when the current effect has no planar version.
+		typedef std::function<bool(PlanarFrame& OutResult, const PlanarFrame& InMerge, float intensity, uint64_t frameIndex)> PlanarGlitchFunc;
+
+		struct TimingStats {
+			double meanMs = 0;
+			double p99Ms = 0;
+		};
+
+		struct Stats {
+			TimingStats stages[STAGE_COUNT];
+			//Capture to end of present.
+			TimingStats latency;
+			uint64_t presented = 0;
+			//Camera frames refused because every allowed slot was busy, plus finished frames skipped for a newer one.
+			uint64_t dropped = 0;
+			//Heap allocations between the last two finished frames, debug builds only.
+			uint64_t allocations = 0;
+			//Processing size of the last finished frame.
+			int rows = 0;
+			int cols = 0;
+			//Frames that ran urgent to make their deadline, and frames that missed it anyway.
+			uint64_t urgent = 0;
+			uint64_t missed = 0;
+			//Frames in the history and the pool memory its slots take.
+			int historyFrames = 0;
+			size_t historyBytes = 0;
+		};
+
+		~FramePipeline();
+
+		//InImg is the background, camera frames are scaled to its size. pool is sized for it and must outlive the pipeline.
+		void setup(FramePool& pool, const cv::Mat& InImg, GlitchFunc glitch, int slots = 3);
+		void stop();
+
+		//Before setup(). Names the analyze and glitch threads in the profiler, "analyze <name>".
+		void setName(const std::string& name) { this->name = name; }
+
+		//Before setup(). With planar on, the merge pass writes planes and planarGlitch runs on them, the frame's result
+		//stays planar (Frame::planar) so that it can be uploaded as planes. Frames it refuses go through glitch as usual.
+		void setPlanarGlitch(PlanarGlitchFunc planarGlitch) { this->planarGlitch = planarGlitch; }
+		void setPlanar(bool enabled) { planar = enabled; }
+
+		void setMaxInFlight(int frames);
+		int getMaxInFlight() const { return maxInFlight; }
+		//Slots frames go through, the history slots not counted.
+		int getSlotCount() const { return slots; }
+
+		//Before setup(). Earlier merged frames kept for the temporal effects, 0 keeps none.
+		void setHistoryDepth(int frames) { historyDepth = std::max(0, frames); }
+		int getHistoryDepth() const { return historyDepth; }
+		//Pool memory of the history slots, after setup().
+		size_t getHistoryBytes() const;
+
+		//Motion mask at 1 / scale of the camera size, taken by the next analyzed frame.
+		void setMaskScale(int scale) { maskScale = std::max(1, scale); }
+		int getMaskScale() const { return maskScale; }
+
+		//Processing time budget per frame, see ResolutionScaler. Off processes at the background size.
+		void setAdaptiveResolution(bool enabled);
+		void setFrameBudgetMs(double ms);
+
+		//Scheduling of this pipeline's passes on the shared pool. deadlineMs is capture to end of glitch,
+		//a frame predicted to miss it runs urgent, 0 sets no deadline.
+		void setPriority(ThreadPool::Level level) { priority = level; }
+		ThreadPool::Level getPriority() const { return priority; }
+		void setDeadlineMs(double ms) { deadlineNanos = int64_t(ms * 1e6); }
+		double getDeadlineMs() const { return deadlineNanos * 1e-6; }
+
+		//Settings changed, the next frames may allocate. Debug builds check that frames stop allocating
+		//warmupFrames after the last change. Allocations are counted process wide, so a change in one pipeline
+		//restarts the warm up of all of them.
+		static void markReconfigured();
+
+		//Main thread. Copies the camera frame into a free slot, returns false when the frame is dropped.
+		bool submit(const cv::Mat& InCam, float alphaCam);
+
+		//Main thread. Newest finished frame or nullptr, must be given back with release() once drawn.
+		Frame* acquireLatest();
+		void release(Frame* frame);
+
+		Stats getStats() const;
+		static const char* getStageName(Stage stage);
+
+	private:
+		static const int warmupFrames = 30;
+
+		void analyzeLoop();
+		void glitchLoop();
+		void recycle(int slot);
+		void unreference(int slot);
+		//Glitch thread. Keeps the merged frame of slot in the history, or empties it when the frame has none.
+		void pushHistory(int slot);
+		void record(Stage stage, Frame& frame, Clock::time_point start);
+		const cv::Mat& getBackground(int rows, int cols);
+		//Level of the passes of a frame about to enter stage, the stages still ahead of it predicted by their last times.
+		ThreadPool::Level getFrameLevel(const Frame& frame, Stage stage) const;
+
+		cv::Mat matImg;
+		cv::Mat matMaskPre;
+		GlitchFunc glitch;
+		PlanarGlitchFunc planarGlitch;
+		std::atomic<bool> planar{ false };
+		uint64_t nextIndex = 0;
+		std::atomic<int> maskScale{ 1 };
+		std::atomic<int> steadyFrames{ 0 };
+		uint64_t allocationsBefore = 0;
+		//Glitch thread, reconfigurations seen so far.
+		uint64_t reconfigurations = 0;
+
+		std::string name;
+		std::atomic<ThreadPool::Level> priority{ ThreadPool::LEVEL_NORMAL };
+		std::atomic<int64_t> deadlineNanos{ 0 };
+		//Last time of each stage, written by the stage and read by the threads ahead of it.
+		std::atomic<int64_t> stageNanos[STAGE_COUNT];
+
+		//Guarded by statsMutex, the glitch thread feeds it and publishes scaleLevel for submit().
+		ResolutionScaler scaler;
+		std::atomic<int> scaleLevel{ 0 };
+		//Background at every smaller processing size met so far, glitch thread only.
+		std::vector<cv::Mat> backgrounds;
+
+		FramePool* pool = nullptr;
+		int slots = 0;
+		std::vector<int> freeSlots;
+		//Oldest first, never more than the slot count.
+		std::vector<int> doneSlots;
+		int inFlight = 0;
+		int maxInFlight = 3;
+		//Guarded by slotMutex. A slot counts once in flight or among the finished frames and once in the history.
+		std::vector<int> slotReferences;
+		//Written by the glitch thread under slotMutex, read by the postprocess of the glitch thread.
+		FrameHistory history;
+		int historyDepth = 0;
+		std::mutex slotMutex;
+
+		std::unique_ptr<BlockingQueue<int>> analyzeQueue;
+		std::unique_ptr<BlockingQueue<int>> glitchQueue;
+		std::thread analyzeThread;
+		std::thread glitchThread;
+
+		mutable std::mutex statsMutex;
+		RollingStats stageStats[STAGE_COUNT];
+		RollingStats latencyStats;
+		uint64_t presented = 0;
+		uint64_t dropped = 0;
+		uint64_t allocations = 0;
+		int rows = 0;
+		int cols = 0;
+		uint64_t urgent = 0;
+		uint64_t missed = 0;
+		int historyFrames = 0;
+};
@@ -0,0 +1,67 @@
+#include "FramePool.h"
+
+#include <algorithm>
+
+using namespace cv;
+
+//--------------------------------------------------------------
+void FramePool::allocate(int rows, int cols, int slots) {
+	if (matches(rows, cols) && size() == slots) {
+		return;
+	}
+	this->rows = rows;
+	this->cols = cols;
+	frames.clear();
+	for (int i = 0; i < slots; i++) {
+		std::unique_ptr<Frame> frame(new Frame());
+		frame->camBuffer.create(rows, cols, CV_8UC3);
+		frame->maskBuffer.create(rows, cols, CV_8UC1);
+		frame->mergeBuffer.create(rows, cols, CV_8UC3);
+		frame->resultBuffer.create(rows, cols, CV_8UC3);
+		//Largest map first, smaller ones keep its capacity.
+		frame->motion.reset(rows, cols);
+		setSize(*frame, rows, cols, 1);
+		frames.push_back(std::move(frame));
+	}
+}
+
+//Mats made over existing data never allocate.
+void FramePool::setSize(Frame& frame, int rows, int cols, int maskScale) {
+	rows = std::min(rows, frame.camBuffer.rows);
+	cols = std::min(cols, frame.camBuffer.cols);
+	if (frame.matCam.rows != rows || frame.matCam.cols != cols) {
+		frame.matCam = Mat(rows, cols, CV_8UC3, frame.camBuffer.data);
+		frame.matMerge = Mat(rows, cols, CV_8UC3, frame.mergeBuffer.data);
+		frame.matResult = Mat(rows, cols, CV_8UC3, frame.resultBuffer.data);
+	}
+	//Same size as analyzeMask gives it.
+	int maskRows = (rows + maskScale - 1) / maskScale;
+	int maskCols = (cols + maskScale - 1) / maskScale;
+	if (frame.matMask.rows != maskRows || frame.matMask.cols != maskCols) {
+		frame.matMask = Mat(maskRows, maskCols, CV_8UC1, frame.maskBuffer.data);
+	}
+	frame.maskScale = maskScale;
+}
+
+//--------------------------------------------------------------
+int FramePool::indexOf(const Frame* frame) const {
+	for (size_t i = 0; i < frames.size(); i++) {
+		if (frames[i].get() == frame) {
+			return int(i);
+		}
+	}
+	return -1;
+}
+
+//--------------------------------------------------------------
+size_t FramePool::getBytes() const {
+	size_t bytes = 0;
+	for (auto& frame : frames) {
+		bytes += frame->camBuffer.total() * frame->camBuffer.elemSize();
+		bytes += frame->maskBuffer.total() * frame->maskBuffer.elemSize();
+		bytes += frame->mergeBuffer.total() * frame->mergeBuffer.elemSize();
+		bytes += frame->resultBuffer.total() * frame->resultBuffer.elemSize();
+		bytes += frame->planarMerge.getBytes() + frame->planarResult.getBytes();
+	}
+	return bytes;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "MotionMap.h"
+#include "PlanarFrame.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+//Every buffer a camera frame needs on its way to the screen, allocated up front for a fixed number of slots.
+//allocate() runs at setup and again only when the full frame size changes, in between nothing is allocated per frame.
+//A frame may be processed smaller than the full size: setSize() points its Mats at the front of the full buffers.
+class FramePool {
+
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		enum Stage {
+			STAGE_CAPTURE,
+			STAGE_ANALYZE,
+			STAGE_GLITCH,
+			STAGE_PRESENT,
+			STAGE_COUNT,
+		};
+
+		struct Frame {
+			//Continuous views of the current frame size into the buffers below.
+			cv::Mat matCam;
+			cv::Mat matMask;
+			MotionMap motion;
+			cv::Mat matMerge;
+			cv::Mat matResult;
+			cv::Mat camBuffer;
+			cv::Mat maskBuffer;
+			cv::Mat mergeBuffer;
+			cv::Mat resultBuffer;
+			//Planar layout, sized by the first frame that uses it. With planar set the result is in planarResult
+			//instead of matResult.
+			PlanarFrame planarMerge;
+			PlanarFrame planarResult;
+			bool planar = false;
+			int maskScale = 1;
+			float alphaCam = 0;
+			float intensity = 0;
+			uint64_t index = 0;
+			Clock::time_point captured;
+			Clock::time_point presentStart;
+			double stageSeconds[STAGE_COUNT] = {};
+		};
+
+		//Does nothing when the pool already has that size and slot count.
+		void allocate(int rows, int cols, int slots);
+
+		bool matches(int rows, int cols) const { return rows == this->rows && cols == this->cols; }
+		int getRows() const { return rows; }
+		int getCols() const { return cols; }
+		int size() const { return int(frames.size()); }
+
+		Frame& get(int slot) { return *frames[slot]; }
+
+		//Processing size of one frame, at most the full size, and the scale of its mask.
+		static void setSize(Frame& frame, int rows, int cols, int maskScale);
+		//-1 for a frame of another pool.
+		int indexOf(const Frame* frame) const;
+
+		//Pixel buffers of every slot.
+		size_t getBytes() const;
+
+	private:
+		int rows = 0;
+		int cols = 0;
+		std::vector<std::unique_ptr<Frame>> frames;
+};
@@ -0,0 +1,341 @@
+#include "FrameRecorder.h"
+#include "Profiler.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace cv;
+
+//--------------------------------------------------------------
+static bool endsWith(const std::string& text, const std::string& suffix) {
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+//Codec of a container, from its extension.
+static int getFourcc(const std::string& path) {
+	if (endsWith(path, ".avi")) {
+		return VideoWriter::fourcc('M', 'J', 'P', 'G');
+	}
+	return VideoWriter::fourcc('m', 'p', '4', 'v');
+}
+
+//--------------------------------------------------------------
+FrameRecorder::~FrameRecorder() {
+	stop();
+}
+
+//--------------------------------------------------------------
+FrameRecorder::Format FrameRecorder::getFormat(const std::string& path) {
+	if (path.find('%') != std::string::npos) {
+		return FORMAT_IMAGES;
+	}
+	if (endsWith(path, ".y4m")) {
+		return FORMAT_Y4M;
+	}
+	return FORMAT_VIDEO;
+}
+
+//--------------------------------------------------------------
+bool FrameRecorder::isValidSequencePattern(const std::string& pattern) {
+	int conversions = 0;
+	for (size_t i = 0; i < pattern.size(); i++) {
+		if (pattern[i] != '%') {
+			continue;
+		}
+		i++;
+		if (i < pattern.size() && pattern[i] == '%') {
+			continue;
+		}
+		while (i < pattern.size() && std::strchr("-+ #0", pattern[i])) {
+			i++;
+		}
+		while (i < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[i]))) {
+			i++;
+		}
+		if (i < pattern.size() && pattern[i] == '.') {
+			i++;
+			while (i < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[i]))) {
+				i++;
+			}
+		}
+		if (i == pattern.size() || !std::strchr("diu", pattern[i])) {
+			return false;
+		}
+		conversions++;
+	}
+	return conversions == 1;
+}
+
+//Sized by a first dry run, a long pattern or a wide field is never cut off.
+std::string FrameRecorder::formatSequencePath(const std::string& pattern, int index) {
+	int length = snprintf(nullptr, 0, pattern.c_str(), index);
+	if (length < 0) {
+		return std::string();
+	}
+	std::vector<char> buffer(size_t(length) + 1);
+	snprintf(buffer.data(), buffer.size(), pattern.c_str(), index);
+	return std::string(buffer.data(), size_t(length));
+}
+
+//--------------------------------------------------------------
+bool FrameRecorder::start(const Settings& newSettings) {
+	stop();
+	settings = newSettings;
+	format = getFormat(settings.path);
+	if (settings.rows <= 0 || settings.cols <= 0) {
+		return false;
+	}
+	if (format == FORMAT_IMAGES && !isValidSequencePattern(settings.path)) {
+		std::cerr << "invalid image sequence pattern " << settings.path << ", expected one integer field such as %05d\n";
+		return false;
+	}
+
+	if (format == FORMAT_VIDEO) {
+		if (!video.open(settings.path, getFourcc(settings.path), settings.fps, Size(settings.cols, settings.rows))) {
+			std::cerr << "cannot open video " << settings.path << "\n";
+			return false;
+		}
+	}
+	else if (format == FORMAT_Y4M) {
+		y4m.open(settings.path, std::ios::binary);
+		if (!y4m) {
+			std::cerr << "cannot write " << settings.path << "\n";
+			return false;
+		}
+		//Frame rate to the millisecond, 29.97 is written 29970:1000.
+		y4m << "YUV4MPEG2 W" << settings.cols << " H" << settings.rows << " F" << int(settings.fps * 1000 + 0.5) << ":1000 Ip A1:1 C444\n";
+	}
+
+	int count = std::max(1, settings.queueFrames);
+	slots.clear();
+	freeSlots.reset(new LockFreeQueue<int>(count));
+	filledSlots.reset(new LockFreeQueue<int>(count));
+	for (int i = 0; i < count; i++) {
+		slots.emplace_back(new Slot());
+		slots.back()->buffer.create(settings.rows, settings.cols, CV_8UC3);
+		freeSlots->tryPush(i);
+	}
+	written = 0;
+	dropped = 0;
+	errors = 0;
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+		writeStats.clear();
+	}
+
+	stopping = false;
+	unsigned threads = format == FORMAT_IMAGES ? std::max(1u, settings.threads) : 1;
+	for (unsigned i = 0; i < threads; i++) {
+		writers.emplace_back(&FrameRecorder::writerLoop, this, i);
+	}
+	recording = true;
+	return true;
+}
+
+//--------------------------------------------------------------
+void FrameRecorder::stop() {
+	recording = false;
+	stopping = true;
+	filled.notify_all();
+	for (auto& writer : writers) {
+		writer.join();
+	}
+	writers.clear();
+	if (video.isOpened()) {
+		video.release();
+	}
+	if (y4m.is_open()) {
+		y4m.close();
+	}
+}
+
+//--------------------------------------------------------------
+bool FrameRecorder::push(const Mat& InRGB, uint64_t index) {
+	if (!recording) {
+		return false;
+	}
+	PROFILE_SCOPE("record");
+	if (InRGB.rows > settings.rows || InRGB.cols > settings.cols) {
+		errors++;
+		return false;
+	}
+	int slot = acquireSlot();
+	if (slot < 0) {
+		return false;
+	}
+	Slot& target = *slots[slot];
+	target.planar = false;
+	target.rows = InRGB.rows;
+	target.cols = InRGB.cols;
+	target.index = index;
+	//The front of the buffer, which never reallocates.
+	Mat view(InRGB.rows, InRGB.cols, CV_8UC3, target.buffer.data);
+	InRGB.copyTo(view);
+	commitSlot(slot);
+	return true;
+}
+
+//--------------------------------------------------------------
+bool FrameRecorder::push(const PlanarFrame& InPlanes, uint64_t index) {
+	if (!recording) {
+		return false;
+	}
+	PROFILE_SCOPE("record");
+	if (InPlanes.getRows() > settings.rows || InPlanes.getCols() > settings.cols) {
+		errors++;
+		return false;
+	}
+	int slot = acquireSlot();
+	if (slot < 0) {
+		return false;
+	}
+	//Planes are interleaved by the writer, not here.
+	Slot& target = *slots[slot];
+	target.planar = true;
+	target.rows = InPlanes.getRows();
+	target.cols = InPlanes.getCols();
+	target.index = index;
+	size_t planeBytes = size_t(target.rows) * target.cols;
+	for (int channel = 0; channel < 3; channel++) {
+		target.planes[channel] = Mat(target.rows, target.cols, CV_8UC1, target.buffer.data + channel * planeBytes);
+		InPlanes.plane(channel).copyTo(target.planes[channel]);
+	}
+	commitSlot(slot);
+	return true;
+}
+
+//--------------------------------------------------------------
+FrameRecorder::Stats FrameRecorder::getStats() const {
+	Stats stats;
+	stats.depth = filledSlots ? filledSlots->size() : 0;
+	stats.capacity = slots.size();
+	stats.written = written;
+	stats.dropped = dropped;
+	stats.errors = errors;
+	std::lock_guard<std::mutex> lock(statsMutex);
+	stats.writeMs = writeStats.mean() * 1e3;
+	return stats;
+}
+
+//Free buffer, or -1 when the frame is dropped.
+int FrameRecorder::acquireSlot() {
+	int slot;
+	if (freeSlots->tryPop(slot)) {
+		return slot;
+	}
+	if (settings.fullPolicy == FULL_DROP) {
+		dropped++;
+		return -1;
+	}
+	std::unique_lock<std::mutex> lock(wakeMutex);
+	while (!freeSlots->tryPop(slot)) {
+		freed.wait_for(lock, std::chrono::milliseconds(1));
+	}
+	return slot;
+}
+
+//The filled queue holds every slot, pushing never fails.
+void FrameRecorder::commitSlot(int slot) {
+	filledSlots->tryPush(slot);
+	filled.notify_one();
+}
+
+//Containers have a single writer, which takes the frames in push order.
+void FrameRecorder::writerLoop(unsigned index) {
+	setProfileThreadName("recorder " + std::to_string(index));
+	Scratch scratch;
+	while (true) {
+		int slot;
+		if (!filledSlots->tryPop(slot)) {
+			//Read before looking at the queue again, so that a frame pushed right before stop() is still written.
+			bool last = stopping;
+			if (!filledSlots->tryPop(slot)) {
+				if (last) {
+					break;
+				}
+				std::unique_lock<std::mutex> lock(wakeMutex);
+				filled.wait_for(lock, std::chrono::milliseconds(10));
+				continue;
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		bool ok;
+		{
+			PROFILE_SCOPE("encode");
+			ok = write(*slots[slot], scratch);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (ok) {
+			written++;
+		}
+		else {
+			errors++;
+		}
+		{
+			std::lock_guard<std::mutex> lock(statsMutex);
+			writeStats.add(seconds);
+		}
+		freeSlots->tryPush(slot);
+		freed.notify_one();
+	}
+}
+
+//--------------------------------------------------------------
+bool FrameRecorder::write(const Slot& slot, Scratch& scratch) {
+	Mat rgb;
+	if (slot.planar) {
+		scratch.merged.create(settings.rows, settings.cols, CV_8UC3);
+		rgb = Mat(slot.rows, slot.cols, CV_8UC3, scratch.merged.data);
+		for (int row = 0; row < slot.rows; row++) {
+			mergeRow(rgb.ptr(row), slot.planes[0].ptr(row), slot.planes[1].ptr(row), slot.planes[2].ptr(row), slot.cols);
+		}
+	}
+	else {
+		rgb = Mat(slot.rows, slot.cols, CV_8UC3, slot.buffer.data);
+	}
+	//Frames processed smaller by adaptive resolution.
+	if (slot.rows != settings.rows || slot.cols != settings.cols) {
+		scratch.scaled.create(settings.rows, settings.cols, CV_8UC3);
+		resize(rgb, scratch.scaled, scratch.scaled.size(), 0, 0, INTER_LINEAR);
+		rgb = scratch.scaled;
+	}
+
+	switch (format) {
+	case FORMAT_Y4M:
+		return writeY4M(rgb, scratch);
+	case FORMAT_IMAGES:
+		cvtColor(rgb, scratch.bgr, COLOR_RGB2BGR);
+		return imwrite(formatSequencePath(settings.path, int(slot.index)), scratch.bgr);
+	default:
+		cvtColor(rgb, scratch.bgr, COLOR_RGB2BGR);
+		video.write(scratch.bgr);
+		return true;
+	}
+}
+
+//BT.601 studio range Y'CbCr at full chroma resolution, planes one after the other.
+bool FrameRecorder::writeY4M(const Mat& InRGB, Scratch& scratch) {
+	size_t pixels = size_t(InRGB.rows) * InRGB.cols;
+	scratch.yuv.resize(pixels * 3);
+	uchar* y = scratch.yuv.data();
+	uchar* u = y + pixels;
+	uchar* v = u + pixels;
+	for (int row = 0; row < InRGB.rows; row++) {
+		const uchar* in = InRGB.ptr(row);
+		for (int col = 0; col < InRGB.cols; col++, in += 3) {
+			int r = in[0];
+			int g = in[1];
+			int b = in[2];
+			*y++ = uchar(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+			*u++ = uchar(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+			*v++ = uchar(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+		}
+	}
+	y4m.write("FRAME\n", 6);
+	y4m.write(reinterpret_cast<const char*>(scratch.yuv.data()), std::streamsize(pixels * 3));
+	return bool(y4m);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "PlanarFrame.h"
+#include "LockFreeQueue.h"
+#include "RollingStats.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Writes finished frames to disk on its own threads, so that recording never holds up the frame loop.
+//push() copies the frame into one of a fixed number of buffers and hands its index to the writers through a
+//lock-free queue: no lock, no allocation and no encoding on the caller's thread. With every buffer waiting to be
+//written, the frame is dropped (live) or push() waits for a writer (offline).
+//Outputs: a video container through cv::VideoWriter, a raw Y4M file (4:4:4, no chroma subsampling) or a numbered
+//image sequence (lossless with PNG), picked from the path.
+class FrameRecorder {
+
+	public:
+		enum Format {
+			FORMAT_VIDEO,
+			FORMAT_Y4M,
+			FORMAT_IMAGES,
+		};
+
+		//What push() does when every buffer is waiting to be written.
+		enum FullPolicy {
+			FULL_DROP,
+			FULL_WAIT,
+		};
+
+		struct Settings {
+			//"out.mp4", "out.y4m" or printf style "out/frame_%05d.png".
+			std::string path;
+			//Recording size, smaller frames are scaled up to it by the writers.
+			int rows = 0;
+			int cols = 0;
+			double fps = 30;
+			//Frames buffered between push() and the writers.
+			int queueFrames = 8;
+			//Writer threads of image sequences, containers are written by one in frame order.
+			unsigned threads = 2;
+			FullPolicy fullPolicy = FULL_DROP;
+		};
+
+		struct Stats {
+			//Frames waiting for a writer, out of capacity buffers.
+			size_t depth = 0;
+			size_t capacity = 0;
+			uint64_t written = 0;
+			uint64_t dropped = 0;
+			uint64_t errors = 0;
+			//Conversion and encoding of one frame.
+			double writeMs = 0;
+		};
+
+		~FrameRecorder();
+
+		static Format getFormat(const std::string& path);
+		//True for a printf style pattern with exactly one int conversion such as "%05d" (d, i or u with flags, width
+		//and precision), "%%" is a literal percent sign. Anything else would read arguments formatSequencePath
+		//does not pass.
+		static bool isValidSequencePattern(const std::string& pattern);
+		//The pattern with index filled in, the pattern must be valid.
+		static std::string formatSequencePath(const std::string& pattern, int index);
+
+		//Opens the output and starts the writers, false when the output cannot be opened.
+		bool start(const Settings& settings);
+		//Writes every frame still queued, then closes the output.
+		void stop();
+		bool isRecording() const { return recording; }
+		const std::string& getPath() const { return settings.path; }
+
+		//Copies the frame, at most the recording size, returns false when it was dropped. index numbers the files
+		//of an image sequence. start(), stop() and push() belong to one thread.
+		bool push(const cv::Mat& InRGB, uint64_t index);
+		bool push(const PlanarFrame& InPlanes, uint64_t index);
+
+		Stats getStats() const;
+
+	private:
+		struct Slot {
+			//Interleaved frames use the front of buffer. Planar ones put their three planes one after the other in
+			//it, planes are views of them.
+			cv::Mat buffer;
+			cv::Mat planes[3];
+			bool planar = false;
+			int rows = 0;
+			int cols = 0;
+			uint64_t index = 0;
+		};
+
+		//Conversion buffers of one writer thread, allocated by its first frame.
+		struct Scratch {
+			cv::Mat merged;
+			cv::Mat scaled;
+			cv::Mat bgr;
+			std::vector<uchar> yuv;
+		};
+
+		int acquireSlot();
+		void commitSlot(int slot);
+		void writerLoop(unsigned index);
+		bool write(const Slot& slot, Scratch& scratch);
+		bool writeY4M(const cv::Mat& InRGB, Scratch& scratch);
+
+		Settings settings;
+		Format format = FORMAT_VIDEO;
+		std::atomic<bool> recording{ false };
+		std::vector<std::unique_ptr<Slot>> slots;
+		std::unique_ptr<LockFreeQueue<int>> freeSlots;
+		std::unique_ptr<LockFreeQueue<int>> filledSlots;
+
+		//Containers, written by the only writer thread.
+		cv::VideoWriter video;
+		std::ofstream y4m;
+
+		std::vector<std::thread> writers;
+		std::atomic<bool> stopping{ false };
+		//Writers sleep here while there is nothing to write, a full FULL_WAIT producer while there is no free slot.
+		//Neither side takes the mutex to signal, a missed wake up only costs the wait timeout.
+		std::mutex wakeMutex;
+		std::condition_variable filled;
+		std::condition_variable freed;
+
+		std::atomic<uint64_t> written{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+		std::atomic<uint64_t> errors{ 0 };
+		mutable std::mutex statsMutex;
+		RollingStats writeStats;
+};
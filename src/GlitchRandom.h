@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+//Stateless counter based random numbers for the kernels. A value only depends on (frame seed, stream, counter),
+//never on which thread asks or in which order, so a frame renders the same for any pool size and can be replayed
+//from its seed. The mixer is the SplitMix64 finalizer, plain integer math that the compiler can unroll and vectorize.
+
+//One stream per use, so that two kernels or two draws inside a kernel never share numbers.
+enum RandomStream {
+	RANDOM_SPLIT_RGB1 = 1,
+	RANDOM_SPLIT_RGB2,
+	RANDOM_SCAN_LINE,
+	RANDOM_SAND,
+	RANDOM_BLOCK1,
+	RANDOM_BLOCK2,
+	RANDOM_DIGITAL_STRIPE,
+	RANDOM_INT_DIGITAL_STRIPE,
+	RANDOM_TIME_SCAN_LINE,
+	RANDOM_FREEZE_BLOCK,
+};
+
+//--------------------------------------------------------------
+inline uint64_t mixRandom(uint64_t x) {
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+//Seed of frame number frameIndex of a run started with baseSeed.
+inline uint64_t deriveFrameSeed(uint64_t baseSeed, uint64_t frameIndex) {
+	return mixRandom(baseSeed ^ mixRandom(frameIndex));
+}
+
+class FrameRandom {
+
+	public:
+		FrameRandom(uint64_t frameSeed, RandomStream stream) : key(mixRandom(frameSeed + mixRandom(uint64_t(stream)))) {}
+
+		uint64_t bits(uint64_t counter) const {
+			return mixRandom(key ^ (counter * 0xD1B54A32D192ED03ull));
+		}
+
+		//Uniform in [0, 1), same range as ofRandomuf.
+		float uniform(uint64_t counter) const {
+			return float(bits(counter) >> 40) * (1.0f / 16777216.0f);
+		}
+
+	private:
+		uint64_t key;
+};
+
+//A base seed as the renderers print it: decimal, up to 2^64 - 1. False for anything else.
+inline bool parseSeed(const std::string& text, uint64_t& OutSeed) {
+	if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+		return false;
+	}
+	try {
+		OutSeed = std::stoull(text);
+	}
+	catch (const std::out_of_range&) {
+		return false;
+	}
+	return true;
+}
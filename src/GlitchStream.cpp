@@ -0,0 +1,319 @@
+#include "GlitchStream.h"
+#include "GlitchRandom.h"
+#include "Profiler.h"
+
+#include <random>
+
+using namespace ofxCv;
+using namespace cv;
+
+//--------------------------------------------------------------
+static void printStreamUsage() {
+	std::cerr << "usage: InteractiveGlitchArtPostprocessing --stream <background> <input> [options] [--stream ...]\n"
+		<< "  background        background image in data/, e.g. cyber.png\n"
+		<< "  input             camera device id, or a video file played in a loop\n"
+		<< "  --effect name,... effect of the stream, several names are chained (default splitRGB1)\n"
+		<< "  --alpha value     camera alpha in [0, 1] (default 0.3)\n"
+		<< "  --priority level  high, normal or low, share of the pool under load (default normal)\n"
+		<< "  --deadline ms     capture to glitched, frames about to miss it run first (default none)\n"
+		<< "  --history n       earlier frames kept for timeScanLine and freezeBlock (default 4)\n"
+		<< "Options apply to the stream before them.\n";
+}
+
+//--------------------------------------------------------------
+bool parseStreamArgs(int argc, char* argv[], std::vector<StreamSettings>& streams) {
+	streams.clear();
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--stream" && i + 2 < argc) {
+			streams.emplace_back();
+			streams.back().background = argv[++i];
+			streams.back().input = argv[++i];
+		}
+		else if (streams.empty()) {
+			printStreamUsage();
+			return false;
+		}
+		else if (arg == "--effect" && hasValue) {
+			streams.back().effect = argv[++i];
+		}
+		else if (arg == "--alpha" && hasValue) {
+			streams.back().alphaCam = std::stof(argv[++i]);
+		}
+		else if (arg == "--priority" && hasValue) {
+			std::string level = argv[++i];
+			if (level == "high") {
+				streams.back().priority = ThreadPool::LEVEL_HIGH;
+			}
+			else if (level == "normal") {
+				streams.back().priority = ThreadPool::LEVEL_NORMAL;
+			}
+			else if (level == "low") {
+				streams.back().priority = ThreadPool::LEVEL_LOW;
+			}
+			else {
+				std::cerr << "unknown priority " << level << "\n";
+				printStreamUsage();
+				return false;
+			}
+		}
+		else if (arg == "--deadline" && hasValue) {
+			streams.back().deadlineMs = std::max(0.0, std::stod(argv[++i]));
+		}
+		else if (arg == "--history" && hasValue) {
+			streams.back().historyDepth = std::max(0, std::stoi(argv[++i]));
+		}
+		else {
+			std::cerr << "unknown option " << arg << "\n";
+			printStreamUsage();
+			return false;
+		}
+	}
+	if (streams.empty()) {
+		printStreamUsage();
+		return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+bool GlitchStream::setup(const StreamSettings& settings, const std::string& name) {
+	this->name = name;
+	//The image merged in the program.
+	if (!img.load(settings.background)) {
+		ofLogError("GlitchStream", "cannot load background " + settings.background);
+		return false;
+	}
+	img.setImageType(OF_IMAGE_COLOR);
+	matImg = toCv(img);
+	alphaCam = settings.alphaCam;
+	//Frame seeds of this stream, see GlitchRandom.h.
+	baseSeed = std::random_device()();
+	texResult.allocate(matImg.cols, matImg.rows, GL_RGB);
+
+	//A comma separated list of effects starts as a chain.
+	{
+		std::lock_guard<std::mutex> lock(effectMutex);
+		std::vector<PostprocessFunc> funcs;
+		std::stringstream effects(settings.effect);
+		std::string effect;
+		while (std::getline(effects, effect, ',')) {
+			PostprocessFunc func = findPostprocess(effect);
+			if (!func) {
+				ofLogError("GlitchStream", "unknown effect " + effect);
+				return false;
+			}
+			funcs.push_back(func);
+		}
+		if (funcs.empty()) {
+			funcs.push_back(splitRGB1);
+		}
+		postprocess = funcs.back();
+		if (funcs.size() > 1) {
+			for (auto func : funcs) {
+				effectChain.append(func);
+			}
+		}
+		useChain = funcs.size() > 1;
+	}
+
+	//Cameras by device id, anything else is a video file. A stream without input shows nothing but keeps its place.
+	useGrabber = !settings.input.empty() && settings.input.find_first_not_of("0123456789") == std::string::npos;
+	if (useGrabber) {
+		videoGrabber.setDeviceID(std::stoi(settings.input));
+		if (!videoGrabber.setup(img.getWidth(), img.getHeight())) {
+			ofLogError("GlitchStream", "cannot open camera " + settings.input);
+		}
+	}
+	else if (videoPlayer.load(settings.input)) {
+		videoPlayer.setLoopState(OF_LOOP_NORMAL);
+		videoPlayer.play();
+	}
+	else {
+		ofLogError("GlitchStream", "cannot open video " + settings.input);
+	}
+
+	pipeline.setName(name);
+	pipeline.setPriority(settings.priority);
+	pipeline.setDeadlineMs(settings.deadlineMs);
+	pipeline.setHistoryDepth(settings.historyDepth);
+	startPipeline();
+	return true;
+}
+
+//--------------------------------------------------------------
+void GlitchStream::startPipeline() {
+	pipeline.setPlanarGlitch([this](PlanarFrame& OutResult, const PlanarFrame& InMerge, float intensity, uint64_t frameIndex) {
+		return glitchFramePlanar(OutResult, InMerge, intensity, frameIndex);
+	});
+	pipeline.setup(framePool, matImg, [this](Mat& OutResult, const Mat& InMerge, float intensity, uint64_t frameIndex) {
+		glitchFrame(OutResult, InMerge, intensity, frameIndex);
+	});
+}
+
+//The pool grows or shrinks by the history slots, which needs the pipeline stopped.
+void GlitchStream::setHistoryDepth(int frames) {
+	if (frames == pipeline.getHistoryDepth()) {
+		return;
+	}
+	pipeline.stop();
+	pipeline.setHistoryDepth(frames);
+	startPipeline();
+	pipeline.markReconfigured();
+}
+
+//--------------------------------------------------------------
+void GlitchStream::stop() {
+	pipeline.stop();
+	recorder.stop();
+	if (useGrabber) {
+		videoGrabber.close();
+	}
+	else {
+		videoPlayer.close();
+	}
+}
+
+//--------------------------------------------------------------
+void GlitchStream::update() {
+	bool isFrameNew;
+	{
+		PROFILE_SCOPE("grab");
+		if (useGrabber) {
+			videoGrabber.update();
+			isFrameNew = videoGrabber.isFrameNew();
+		}
+		else {
+			videoPlayer.update();
+			isFrameNew = videoPlayer.isFrameNew();
+		}
+	}
+	if (isFrameNew) {
+		//Copied into a pipeline slot, analysis and glitch run on their own threads.
+		pipeline.submit(toCv(useGrabber ? videoGrabber.getPixels() : videoPlayer.getPixels()), alphaCam);
+	}
+}
+
+//Glitch thread.
+void GlitchStream::glitchFrame(Mat& OutResult, const Mat& InMerge, float intensity, uint64_t frameIndex) {
+	setFrameSeed(deriveFrameSeed(baseSeed, frameIndex));
+
+	//Process to get final result.
+	std::lock_guard<std::mutex> lock(effectMutex);
+	if (useChain && !effectChain.empty()) {
+		effectChain.process(OutResult, InMerge, intensity);
+	}
+	else {
+		const PostprocessEntry* entry = findPostprocessEntry(postprocess);
+		PROFILE_SCOPE(entry ? entry->name : "effect");
+		postprocess(OutResult, InMerge, intensity);
+	}
+}
+
+//Glitch thread. Chains and effects without a planar version fall back to glitchFrame.
+bool GlitchStream::glitchFramePlanar(PlanarFrame& OutResult, const PlanarFrame& InMerge, float intensity, uint64_t frameIndex) {
+	std::lock_guard<std::mutex> lock(effectMutex);
+	const PostprocessEntry* entry = findPostprocessEntry(postprocess);
+	if ((useChain && !effectChain.empty()) || !entry || !entry->planar) {
+		return false;
+	}
+	setFrameSeed(deriveFrameSeed(baseSeed, frameIndex));
+	PROFILE_SCOPE(entry->name);
+	entry->planar(OutResult, InMerge, intensity);
+	return true;
+}
+
+//--------------------------------------------------------------
+void GlitchStream::draw(float x, float y, ofShader& shaderPlanes) {
+	if (Frame* frame = pipeline.acquireLatest()) {
+		PROFILE_SCOPE("upload");
+		//Adaptive resolution changes the frame size, the textures follow it.
+		int cols = frame->matCam.cols;
+		int rows = frame->matCam.rows;
+		drawPlanes = frame->planar;
+		if (drawPlanes) {
+			//Planes go up as they are, they are never interleaved on the CPU.
+			for (int channel = 0; channel < 3; channel++) {
+				if (texPlanes[channel].getWidth() != cols || texPlanes[channel].getHeight() != rows) {
+					texPlanes[channel].allocate(cols, rows, GL_LUMINANCE);
+				}
+				texPlanes[channel].loadData(frame->planarResult.plane(channel).data, cols, rows, GL_LUMINANCE);
+			}
+		}
+		else {
+			if (texResult.getWidth() != cols || texResult.getHeight() != rows) {
+				texResult.allocate(cols, rows, GL_RGB);
+			}
+			texResult.loadData(frame->matResult.data, cols, rows, GL_RGB);
+		}
+		if (recorder.isRecording()) {
+			if (drawPlanes) {
+				recorder.push(frame->planarResult, frame->index);
+			}
+			else {
+				recorder.push(frame->matResult, frame->index);
+			}
+		}
+		drawnIndex = frame->index;
+		pipeline.release(frame);
+	}
+	if (drawPlanes) {
+		shaderPlanes.begin();
+		shaderPlanes.setUniformTexture("planeRed", texPlanes[0], 0);
+		shaderPlanes.setUniformTexture("planeGreen", texPlanes[1], 1);
+		shaderPlanes.setUniformTexture("planeBlue", texPlanes[2], 2);
+		texPlanes[0].draw(x, y, getWidth(), getHeight());
+		shaderPlanes.end();
+	}
+	else {
+		texResult.draw(x, y, getWidth(), getHeight());
+	}
+}
+
+//--------------------------------------------------------------
+void GlitchStream::setPostprocess(PostprocessFunc func, bool appendToChain) {
+	std::lock_guard<std::mutex> lock(effectMutex);
+	postprocess = func;
+	if (appendToChain) {
+		effectChain.append(func);
+	}
+	pipeline.markReconfigured();
+}
+
+//--------------------------------------------------------------
+void GlitchStream::clearChain() {
+	std::lock_guard<std::mutex> lock(effectMutex);
+	effectChain.clear();
+	pipeline.markReconfigured();
+}
+
+//--------------------------------------------------------------
+void GlitchStream::setUseChain(bool enabled) {
+	if (useChain != enabled) {
+		useChain = enabled;
+		pipeline.markReconfigured();
+	}
+}
+
+//--------------------------------------------------------------
+std::string GlitchStream::describeChain() {
+	std::lock_guard<std::mutex> lock(effectMutex);
+	return effectChain.describe();
+}
+
+//--------------------------------------------------------------
+bool GlitchStream::startRecording(const std::string& path, double fps) {
+	FrameRecorder::Settings settings;
+	settings.path = path;
+	settings.rows = matImg.rows;
+	settings.cols = matImg.cols;
+	settings.fps = fps;
+	settings.fullPolicy = FrameRecorder::FULL_DROP;
+	return recorder.start(settings);
+}
+
+//--------------------------------------------------------------
+std::string GlitchStream::describeSeed() const {
+	return std::to_string(baseSeed) + " / " + std::to_string(drawnIndex);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "Postprocess.h"
+#include "EffectChain.h"
+#include "FramePipeline.h"
+#include "FrameRecorder.h"
+
+//One screen of an installation: input -> merge -> effect -> output with its own background, camera alpha, effect
+//and motion state. Every stream of the process glitches on the shared postprocess pool, see FramePipeline.
+struct StreamSettings {
+	//Background image in data/.
+	std::string background = "cyber.png";
+	//Camera device id, or a video file played in a loop.
+	std::string input = "0";
+	//One effect name or a comma separated chain.
+	std::string effect = "splitRGB1";
+	float alphaCam = 0.3f;
+	ThreadPool::Level priority = ThreadPool::LEVEL_NORMAL;
+	//Capture to end of glitch, 0 for none.
+	double deadlineMs = 0;
+	//Earlier merged frames kept for timeScanLine and freezeBlock, each one a pool slot at the background size.
+	int historyDepth = 4;
+};
+
+//Parses repeated "--stream <background> <input> [options]" arguments, returns false and prints usage on error.
+bool parseStreamArgs(int argc, char* argv[], std::vector<StreamSettings>& streams);
+
+class GlitchStream {
+
+	public:
+		typedef FramePipeline::Frame Frame;
+
+		//Loads the background, opens the input and starts the pipeline. The postprocess pool must be set.
+		bool setup(const StreamSettings& settings, const std::string& name);
+		void stop();
+
+		//Main thread. Submits the new input frame, if any.
+		void update();
+
+		//Main thread. Uploads the newest finished frame and draws the result at the background size.
+		void draw(float x, float y, ofShader& shaderPlanes);
+
+		//GUI side of the effect state, the glitch thread picks the changes up with the next frame.
+		void setPostprocess(PostprocessFunc func, bool appendToChain);
+		void clearChain();
+		void setUseChain(bool enabled);
+		bool getUseChain() const { return useChain; }
+		std::string describeChain();
+
+		//Main thread. Restarts the pipeline with a new history depth, frames in flight are dropped.
+		void setHistoryDepth(int frames);
+
+		void setAlphaCam(float alpha) { alphaCam = alpha; }
+		float getAlphaCam() const { return alphaCam; }
+
+		FramePipeline& getPipeline() { return pipeline; }
+		const FramePool& getFramePool() const { return framePool; }
+		const cv::Mat& getBackground() const { return matImg; }
+		float getWidth() const { return float(matImg.cols); }
+		float getHeight() const { return float(matImg.rows); }
+		const std::string& getName() const { return name; }
+
+		//"<base seed> / <frame index>" of the last drawn frame, replays it in an offline render.
+		std::string describeSeed() const;
+
+		//Main thread. Every drawn frame also goes to path (see FrameRecorder) at the background size, frames the
+		//writers cannot keep up with are dropped from the recording, never from the screen.
+		bool startRecording(const std::string& path, double fps);
+		void stopRecording() { recorder.stop(); }
+		const FrameRecorder& getRecorder() const { return recorder; }
+
+	private:
+		void startPipeline();
+		void glitchFrame(cv::Mat& OutResult, const cv::Mat& InMerge, float intensity, uint64_t frameIndex);
+		bool glitchFramePlanar(PlanarFrame& OutResult, const PlanarFrame& InMerge, float intensity, uint64_t frameIndex);
+
+		std::string name;
+		ofImage img;
+		cv::Mat matImg;
+		std::atomic<float> alphaCam{ 0.3f };
+
+		//Input, a camera or a looping video.
+		bool useGrabber = true;
+		ofVideoGrabber videoGrabber;
+		ofVideoPlayer videoPlayer;
+
+		//Result, uploaded from the newest finished pipeline frame. Planar frames: one texture per plane,
+		//put together by the caller's shader while drawing.
+		ofTexture texResult;
+		ofTexture texPlanes[3];
+		bool drawPlanes = false;
+
+		//Base seed, with the frame number it replays the random part of a frame.
+		uint64_t baseSeed = 0;
+		uint64_t drawnIndex = 0;
+
+		//The GUI changes the effect while the glitch thread runs it.
+		std::mutex effectMutex;
+		std::atomic<bool> useChain{ false };
+		PostprocessFunc postprocess = splitRGB1;
+		//Effects stacked while the chain is on, in click order.
+		EffectChain effectChain;
+
+		FrameRecorder recorder;
+
+		//Every per frame buffer, allocated at setup.
+		FramePool framePool;
+		//Declared after the frame pool so that it stops first.
+		FramePipeline pipeline;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+//Bounded multi producer, multi consumer queue that never blocks and never allocates after construction
+//(D. Vyukov's ring of sequenced cells). tryPush fails when full and tryPop when empty, the caller decides whether
+//to wait, drop or do something else, unlike BlockingQueue which always holds the producer back.
+template<class T>
+class LockFreeQueue {
+
+	public:
+		//Capacity is rounded up to a power of two.
+		explicit LockFreeQueue(size_t capacity) {
+			size_t size = 2;
+			while (size < capacity) {
+				size *= 2;
+			}
+			mask = size - 1;
+			cells.reset(new Cell[size]);
+			for (size_t i = 0; i < size; i++) {
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		LockFreeQueue(const LockFreeQueue&) = delete;
+		LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+		size_t capacity() const { return mask + 1; }
+
+		//Items queued, exact only while nobody pushes or pops.
+		size_t size() const {
+			size_t tail = dequeuePosition.load(std::memory_order_relaxed);
+			size_t head = enqueuePosition.load(std::memory_order_relaxed);
+			return head > tail ? head - tail : 0;
+		}
+
+		bool tryPush(const T& value) {
+			size_t position = enqueuePosition.load(std::memory_order_relaxed);
+			while (true) {
+				Cell& cell = cells[position & mask];
+				size_t sequence = cell.sequence.load(std::memory_order_acquire);
+				//The cell is free for this lap, or still holds the item of the previous lap (full).
+				ptrdiff_t difference = ptrdiff_t(sequence) - ptrdiff_t(position);
+				if (difference == 0) {
+					if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						cell.value = value;
+						cell.sequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0) {
+					return false;
+				}
+				else {
+					position = enqueuePosition.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		bool tryPop(T& value) {
+			size_t position = dequeuePosition.load(std::memory_order_relaxed);
+			while (true) {
+				Cell& cell = cells[position & mask];
+				size_t sequence = cell.sequence.load(std::memory_order_acquire);
+				ptrdiff_t difference = ptrdiff_t(sequence) - ptrdiff_t(position + 1);
+				if (difference == 0) {
+					if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						value = cell.value;
+						cell.sequence.store(position + mask + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0) {
+					return false;
+				}
+				else {
+					position = dequeuePosition.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+	private:
+		struct Cell {
+			std::atomic<size_t> sequence;
+			T value;
+		};
+
+		std::unique_ptr<Cell[]> cells;
+		size_t mask = 0;
+		//Padded apart so that producers and consumers do not share a cache line.
+		char padding0[64];
+		std::atomic<size_t> enqueuePosition{ 0 };
+		char padding1[64];
+		std::atomic<size_t> dequeuePosition{ 0 };
+};
@@ -0,0 +1,124 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Views must start on a multiple of it.
+static uint64_t getGranularity() {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+#else
+	return uint64_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+//--------------------------------------------------------------
+MappedFile::~MappedFile() {
+	close();
+}
+
+//--------------------------------------------------------------
+bool MappedFile::open(const std::string& path) {
+	close();
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		close();
+		return false;
+	}
+	size = uint64_t(fileSize.QuadPart);
+#else
+	file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0) {
+		close();
+		return false;
+	}
+	size = uint64_t(info.st_size);
+#endif
+	return true;
+}
+
+//--------------------------------------------------------------
+void MappedFile::close() {
+	unmap();
+#ifdef _WIN32
+	if (mapping) {
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+	if (file) {
+		CloseHandle(file);
+		file = nullptr;
+	}
+#else
+	if (file >= 0) {
+		::close(file);
+		file = -1;
+	}
+#endif
+	size = 0;
+}
+
+//--------------------------------------------------------------
+const uint8_t* MappedFile::map(uint64_t offset, size_t length) {
+	unmap();
+	if (!isOpen() || length == 0 || offset + length > size) {
+		return nullptr;
+	}
+	uint64_t start = offset - offset % getGranularity();
+	size_t lead = size_t(offset - start);
+#ifdef _WIN32
+	view = MapViewOfFile(mapping, FILE_MAP_READ, DWORD(start >> 32), DWORD(start & 0xffffffff), lead + length);
+	if (!view) {
+		return nullptr;
+	}
+#else
+	view = mmap(nullptr, lead + length, PROT_READ, MAP_PRIVATE, file, off_t(start));
+	if (view == MAP_FAILED) {
+		view = nullptr;
+		return nullptr;
+	}
+	//Read once front to back.
+	madvise(view, lead + length, MADV_SEQUENTIAL);
+#endif
+	viewLength = lead + length;
+	return static_cast<const uint8_t*>(view) + lead;
+}
+
+//--------------------------------------------------------------
+void MappedFile::unmap() {
+	if (!view) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(view);
+#else
+	munmap(view, viewLength);
+#endif
+	view = nullptr;
+	viewLength = 0;
+}
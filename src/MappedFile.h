@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//Read only view of a window of a file, so that files larger than memory can be read a part at a time. Only the
+//pages of the current view take memory, and the OS may drop them again at any time since they are backed by the file.
+class MappedFile {
+
+	public:
+		MappedFile() {}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		bool open(const std::string& path);
+		void close();
+		bool isOpen() const { return size > 0; }
+		uint64_t getSize() const { return size; }
+
+		//Maps bytes [offset, offset + length), replacing the previous view. nullptr past the end of the file or on
+		//failure. Valid until the next map(), unmap() or close().
+		const uint8_t* map(uint64_t offset, size_t length);
+		void unmap();
+
+	private:
+#ifdef _WIN32
+		//HANDLEs of the file and of its mapping.
+		void* file = nullptr;
+		void* mapping = nullptr;
+#else
+		int file = -1;
+#endif
+		uint64_t size = 0;
+		//Views start on the allocation granularity, the caller's bytes begin after it.
+		void* view = nullptr;
+		size_t viewLength = 0;
+};
@@ -0,0 +1,64 @@
+#include "MotionMap.h"
+
+#include <algorithm>
+
+const int MotionMap::tileSize;
+
+//--------------------------------------------------------------
+void MotionMap::reset(int rows, int cols, int scale) {
+	this->rows = rows;
+	this->cols = cols;
+	this->scale = std::max(1, scale);
+	maskRows = (rows + this->scale - 1) / this->scale;
+	maskCols = (cols + this->scale - 1) / this->scale;
+	tileRows = (maskRows + tileSize - 1) / tileSize;
+	tileCols = (maskCols + tileSize - 1) / tileSize;
+	counts.assign(size_t(tileRows) * tileCols, 0);
+	changed = 0;
+}
+
+//--------------------------------------------------------------
+void MotionMap::finish() {
+	changed = 0;
+	for (uint32_t count : counts) {
+		changed += count;
+	}
+}
+
+//--------------------------------------------------------------
+float MotionMap::getFrameFraction() const {
+	if (maskRows == 0 || maskCols == 0) {
+		return 0;
+	}
+	return float(changed) / (float(maskRows) * float(maskCols));
+}
+
+//--------------------------------------------------------------
+float MotionMap::getRegionFraction(int rowBegin, int rowEnd, int colBegin, int colEnd) const {
+	int tilePixels = tileSize * scale;
+	int tileRowBegin = std::max(0, rowBegin / tilePixels);
+	int tileRowEnd = std::min(tileRows, (rowEnd + tilePixels - 1) / tilePixels);
+	int tileColBegin = std::max(0, colBegin / tilePixels);
+	int tileColEnd = std::min(tileCols, (colEnd + tilePixels - 1) / tilePixels);
+
+	uint64_t regionChanged = 0;
+	uint64_t pixels = 0;
+	for (int tileRow = tileRowBegin; tileRow < tileRowEnd; tileRow++) {
+		int tileHeight = std::min(tileSize, maskRows - tileRow * tileSize);
+		for (int tileCol = tileColBegin; tileCol < tileColEnd; tileCol++) {
+			regionChanged += counts[size_t(tileRow) * tileCols + tileCol];
+			pixels += uint64_t(tileHeight) * std::min(tileSize, maskCols - tileCol * tileSize);
+		}
+	}
+	return pixels ? float(regionChanged) / float(pixels) : getFrameFraction();
+}
+
+//--------------------------------------------------------------
+float MotionMap::getRegionIntensity(float intensity, int rowBegin, int rowEnd, int colBegin, int colEnd) const {
+	float frame = getFrameFraction();
+	if (frame <= 0) {
+		return intensity;
+	}
+	float region = getRegionFraction(rowBegin, rowEnd, colBegin, colEnd);
+	return std::min(1.0f, intensity * region / frame);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Where the mask changed since the previous frame, counted per tileSize x tileSize tile of the mask.
+//analyzeMask fills it one tile row per task, so workers never share a counter.
+//Effects read it through getMotionMap() to glitch harder where the person moves.
+//The mask may be computed at 1 / scale of the frame size, regions are always given in frame pixels.
+class MotionMap {
+
+	public:
+		static const int tileSize = 32;
+
+		//Clears every count, the last row and column of tiles may be partial.
+		void reset(int rows, int cols, int scale = 1);
+
+		int getRows() const { return rows; }
+		int getCols() const { return cols; }
+		int getScale() const { return scale; }
+		int getMaskRows() const { return maskRows; }
+		int getMaskCols() const { return maskCols; }
+		int getTileRows() const { return tileRows; }
+		int getTileCols() const { return tileCols; }
+		bool matches(int rows, int cols) const { return rows == this->rows && cols == this->cols; }
+
+		//Changed mask pixels of one tile row, written only by the task that owns it.
+		uint32_t* getTileRow(int tileRow) { return counts.data() + size_t(tileRow) * tileCols; }
+		//Sums the tiles once they are all written.
+		void finish();
+
+		//Fraction of changed pixels over the whole frame, the scalar intensity of earlier versions.
+		float getFrameFraction() const;
+
+		//Fraction of changed pixels in the tiles touching rows [rowBegin, rowEnd) and columns [colBegin, colEnd).
+		float getRegionFraction(int rowBegin, int rowEnd, int colBegin, int colEnd) const;
+
+		//Scales a frame intensity for a region by how much more (or less) it moves than the frame on average,
+		//clamped to [0, 1]. A still frame keeps intensity everywhere.
+		float getRegionIntensity(float intensity, int rowBegin, int rowEnd, int colBegin, int colEnd) const;
+
+	private:
+		int rows = 0;
+		int cols = 0;
+		int scale = 1;
+		int maskRows = 0;
+		int maskCols = 0;
+		int tileRows = 0;
+		int tileCols = 0;
+		uint64_t changed = 0;
+		std::vector<uint32_t> counts;
+};
@@ -0,0 +1,176 @@
+#include "PlanarFrame.h"
+#include "Postprocess.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PLANAR_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//Same as Blend.cpp: GCC and clang need the target enabled per function.
+#if defined(PLANAR_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PLANAR_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define PLANAR_TARGET_SSSE3
+#endif
+
+using namespace cv;
+
+typedef void (*SplitRowFunc)(uchar* red, uchar* green, uchar* blue, const uchar* in, int count);
+typedef void (*MergeRowFunc)(uchar* out, const uchar* red, const uchar* green, const uchar* blue, int count);
+
+//--------------------------------------------------------------
+static void splitRowScalar(uchar* red, uchar* green, uchar* blue, const uchar* in, int count) {
+	for (int i = 0; i < count; i++) {
+		red[i] = in[i * 3];
+		green[i] = in[i * 3 + 1];
+		blue[i] = in[i * 3 + 2];
+	}
+}
+
+//--------------------------------------------------------------
+static void mergeRowScalar(uchar* out, const uchar* red, const uchar* green, const uchar* blue, int count) {
+	for (int i = 0; i < count; i++) {
+		out[i * 3] = red[i];
+		out[i * 3 + 1] = green[i];
+		out[i * 3 + 2] = blue[i];
+	}
+}
+
+#ifdef PLANAR_X86
+//16 pixels are 48 interleaved bytes in three registers. Byte i of plane channel is interleaved byte 3 * i + channel,
+//each of the three registers holds some of them: one shuffle per register and plane, or'ed together.
+//Shuffle indices with the high bit set give zero.
+static __m128i splitMask(int channel, int part) {
+	alignas(16) char mask[16];
+	for (int i = 0; i < 16; i++) {
+		int index = 3 * i + channel - 16 * part;
+		mask[i] = index >= 0 && index < 16 ? char(index) : char(-1);
+	}
+	return _mm_load_si128((const __m128i*)mask);
+}
+
+//Byte i of interleaved register part is plane (16 * part + i) % 3 at pixel (16 * part + i) / 3.
+static __m128i mergeMask(int channel, int part) {
+	alignas(16) char mask[16];
+	for (int i = 0; i < 16; i++) {
+		int index = 16 * part + i;
+		mask[i] = index % 3 == channel ? char(index / 3) : char(-1);
+	}
+	return _mm_load_si128((const __m128i*)mask);
+}
+
+//--------------------------------------------------------------
+PLANAR_TARGET_SSSE3 static void splitRowSSSE3(uchar* red, uchar* green, uchar* blue, const uchar* in, int count) {
+	__m128i masks[3][3];
+	for (int channel = 0; channel < 3; channel++) {
+		for (int part = 0; part < 3; part++) {
+			masks[channel][part] = splitMask(channel, part);
+		}
+	}
+	uchar* planes[3] = { red, green, blue };
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i parts[3];
+		for (int part = 0; part < 3; part++) {
+			parts[part] = _mm_loadu_si128((const __m128i*)(in + i * 3 + part * 16));
+		}
+		for (int channel = 0; channel < 3; channel++) {
+			__m128i plane = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(parts[0], masks[channel][0]),
+				_mm_shuffle_epi8(parts[1], masks[channel][1])), _mm_shuffle_epi8(parts[2], masks[channel][2]));
+			_mm_storeu_si128((__m128i*)(planes[channel] + i), plane);
+		}
+	}
+	splitRowScalar(red + i, green + i, blue + i, in + i * 3, count - i);
+}
+
+//--------------------------------------------------------------
+PLANAR_TARGET_SSSE3 static void mergeRowSSSE3(uchar* out, const uchar* red, const uchar* green, const uchar* blue, int count) {
+	__m128i masks[3][3];
+	for (int channel = 0; channel < 3; channel++) {
+		for (int part = 0; part < 3; part++) {
+			masks[channel][part] = mergeMask(channel, part);
+		}
+	}
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i planes[3] = {
+			_mm_loadu_si128((const __m128i*)(red + i)),
+			_mm_loadu_si128((const __m128i*)(green + i)),
+			_mm_loadu_si128((const __m128i*)(blue + i)),
+		};
+		for (int part = 0; part < 3; part++) {
+			__m128i bytes = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(planes[0], masks[0][part]),
+				_mm_shuffle_epi8(planes[1], masks[1][part])), _mm_shuffle_epi8(planes[2], masks[2][part]));
+			_mm_storeu_si128((__m128i*)(out + i * 3 + part * 16), bytes);
+		}
+	}
+	mergeRowScalar(out + i * 3, red + i, green + i, blue + i, count - i);
+}
+
+//--------------------------------------------------------------
+static bool cpuHasSSSE3() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 9)) != 0;
+#else
+	return __builtin_cpu_supports("ssse3");
+#endif
+}
+#endif
+
+//--------------------------------------------------------------
+void splitRow(uchar* red, uchar* green, uchar* blue, const uchar* in, int count) {
+#ifdef PLANAR_X86
+	static const SplitRowFunc best = cpuHasSSSE3() ? splitRowSSSE3 : splitRowScalar;
+#else
+	static const SplitRowFunc best = splitRowScalar;
+#endif
+	best(red, green, blue, in, count);
+}
+
+//--------------------------------------------------------------
+void mergeRow(uchar* out, const uchar* red, const uchar* green, const uchar* blue, int count) {
+#ifdef PLANAR_X86
+	static const MergeRowFunc best = cpuHasSSSE3() ? mergeRowSSSE3 : mergeRowScalar;
+#else
+	static const MergeRowFunc best = mergeRowScalar;
+#endif
+	best(out, red, green, blue, count);
+}
+
+//--------------------------------------------------------------
+void PlanarFrame::create(int rows, int cols) {
+	size_t planeBytes = size_t(rows) * cols;
+	if (buffer.total() < planeBytes * 3) {
+		buffer.create(1, int(planeBytes * 3), CV_8UC1);
+	}
+	this->rows = rows;
+	this->cols = cols;
+	//Headers over the buffer, nothing is allocated.
+	for (int channel = 0; channel < 3; channel++) {
+		planes[channel] = Mat(rows, cols, CV_8UC1, buffer.data + planeBytes * channel);
+	}
+}
+
+//--------------------------------------------------------------
+void splitPlanes(PlanarFrame& OutPlanes, const Mat& InMat) {
+	OutPlanes.create(InMat.rows, InMat.cols);
+	getPostprocessPool().parallelFor(0, InMat.rows, 0, [&](int rowBegin, int rowEnd) {
+		for (int row = rowBegin; row < rowEnd; row++) {
+			splitRow(OutPlanes.plane(0).ptr(row), OutPlanes.plane(1).ptr(row), OutPlanes.plane(2).ptr(row), InMat.ptr(row), InMat.cols);
+		}
+	});
+}
+
+//--------------------------------------------------------------
+void mergePlanes(Mat& OutMat, const PlanarFrame& InPlanes) {
+	getPostprocessPool().parallelFor(0, InPlanes.getRows(), 0, [&](int rowBegin, int rowEnd) {
+		for (int row = rowBegin; row < rowEnd; row++) {
+			mergeRow(OutMat.ptr(row), InPlanes.plane(0).ptr(row), InPlanes.plane(1).ptr(row), InPlanes.plane(2).ptr(row), InPlanes.getCols());
+		}
+	});
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+//A frame as three single channel planes, red, green and blue, in one buffer. splitRGB and block only move red and
+//blue apart and pass green through: on planes a shift is a rotation of contiguous bytes instead of a stride 3
+//gather, and green can be shared with the input instead of copied. The merge pass writes planes directly, the
+//result is interleaved once for the texture upload.
+class PlanarFrame {
+
+	public:
+		//Planes of rows x cols. The buffer is only reallocated when it has to grow.
+		void create(int rows, int cols);
+
+		int getRows() const { return rows; }
+		int getCols() const { return cols; }
+
+		cv::Mat& plane(int channel) { return planes[channel]; }
+		const cv::Mat& plane(int channel) const { return planes[channel]; }
+
+		//Makes a plane a view of the same plane of another frame, which must outlive its use. create() undoes it.
+		void share(int channel, const PlanarFrame& other) { planes[channel] = other.planes[channel]; }
+
+		size_t getBytes() const { return buffer.total(); }
+
+	private:
+		cv::Mat buffer;
+		cv::Mat planes[3];
+		int rows = 0;
+		int cols = 0;
+};
+
+//One row of count pixels from interleaved to planes and back. 16 pixels per step with SSSE3 byte shuffles
+//where the CPU has them, picked once at run time.
+void splitRow(uchar* red, uchar* green, uchar* blue, const uchar* in, int count);
+void mergeRow(uchar* out, const uchar* red, const uchar* green, const uchar* blue, int count);
+
+//Interleaved CV_8UC3 to planes and back, on the postprocess pool. OutMat must already have the planes' size.
+void splitPlanes(PlanarFrame& OutPlanes, const cv::Mat& InMat);
+void mergePlanes(cv::Mat& OutMat, const PlanarFrame& InPlanes);
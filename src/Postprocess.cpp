@@ -0,0 +1,871 @@
+#include "Postprocess.h"
+#include "Blend.h"
+#include "RowRemap.h"
+#include "RowKernel.h"
+#include "GlitchRandom.h"
+#include "Profiler.h"
+
+#include <cfloat>
+#include <cstring>
+
+using namespace cv;
+
+//Multi-threading. The bottleneck of this program is iterating each pixel per frame,
+//which could be highly optimized by software concurrency.
+//Every pass hands bands of rows to this pool, owned by whoever drives the frames and shared by every stream.
+static ThreadPool* threadPool = nullptr;
+
+//The frame state below belongs to the thread running the postprocess, so that streams glitching on their own threads
+//do not see each other's frames. Stages only read it in prepare(), on that thread.
+//Every random number of a frame derives from this, see GlitchRandom.h.
+static thread_local uint64_t frameSeed = 0;
+
+//Per tile motion of the frame, see MotionMap.h.
+static thread_local const MotionMap* motionMap = nullptr;
+
+//Earlier merged frames, see FrameHistory.h.
+static thread_local const FrameHistory* frameHistory = nullptr;
+
+//Processing size over the size the pixel offsets were tuned for.
+static thread_local float pixelScale = 1;
+
+//Tuning of the effects, in pixels of the background they were made for. They are template arguments of the stages,
+//so every effect is compiled with its own constants.
+//Largest split or jump of splitRGB, scanLine and sand.
+static const int shiftScale = 250;
+//Largest split of a block at full noise.
+static const int blockShiftScale = 5;
+//Blocks per side of the block grid.
+static const int blockCount = 10;
+//Stripe clusters per frame height, rowClusterNum = rows / clusters.
+static const int digitalStripeClusters = 25;
+static const int intDigitalStripeClusters = 30;
+
+//--------------------------------------------------------------
+void setPostprocessPool(ThreadPool* pool) {
+	threadPool = pool;
+}
+
+//--------------------------------------------------------------
+ThreadPool& getPostprocessPool() {
+	return *threadPool;
+}
+
+//--------------------------------------------------------------
+void setFrameSeed(uint64_t seed) {
+	frameSeed = seed;
+}
+
+//--------------------------------------------------------------
+uint64_t getFrameSeed() {
+	return frameSeed;
+}
+
+//--------------------------------------------------------------
+void setMotionMap(const MotionMap* motion) {
+	motionMap = motion;
+}
+
+//--------------------------------------------------------------
+const MotionMap* getMotionMap() {
+	return motionMap;
+}
+
+//--------------------------------------------------------------
+void setFrameHistory(const FrameHistory* history) {
+	frameHistory = history;
+}
+
+//--------------------------------------------------------------
+const FrameHistory* getFrameHistory() {
+	return frameHistory;
+}
+
+//--------------------------------------------------------------
+void setPixelScale(float scale) {
+	pixelScale = scale;
+}
+
+//--------------------------------------------------------------
+float getPixelScale() {
+	return pixelScale;
+}
+
+//Intensity of a region of a rows x cols frame, the frame intensity without a matching motion map.
+static float regionIntensity(float intensity, int rows, int cols, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+	if (!motionMap || !motionMap->matches(rows, cols)) {
+		return intensity;
+	}
+	return motionMap->getRegionIntensity(intensity, rowBegin, rowEnd, colBegin, colEnd);
+}
+
+//Earlier merged frames of a rows x cols frame, newest first, up to the first one missing or of another size.
+static void collectPastFrames(std::vector<const Mat*>& OutPast, int rows, int cols) {
+	OutPast.clear();
+	if (!frameHistory) {
+		return;
+	}
+	OutPast.reserve(frameHistory->capacity());
+	for (int age = 1; age <= frameHistory->size(); age++) {
+		const Mat* merge = frameHistory->getMerge(age, rows, cols);
+		if (!merge) {
+			break;
+		}
+		OutPast.push_back(merge);
+	}
+}
+
+//--------------------------------------------------------------
+void GlitchStage::processFrame(Mat& OutResult, const Mat& InMat) const {
+	forEachRow(*threadPool, InMat.rows, [&](int row) {
+		processRow(OutResult.ptr(row), InMat.ptr(row), row);
+	});
+}
+
+//Frame row of a strip row, which may lie past either edge.
+static int wrapRow(int row, int rows) {
+	return (row % rows + rows) % rows;
+}
+
+//--------------------------------------------------------------
+void GlitchStage::processStrip(Mat& OutStrip, const Mat& InWindow, int windowBegin, int rowBegin, int rowEnd, int frameRows) const {
+	forEachRow(*threadPool, rowEnd - rowBegin, [&](int row) {
+		processRow(OutStrip.ptr(row), InWindow.ptr(rowBegin + row - windowBegin), wrapRow(rowBegin + row, frameRows));
+	});
+}
+
+//Runs one stage alone as a plain postprocess. Each postprocess keeps one stage per thread across frames,
+//so that per frame buffers and caches are reused instead of allocated again.
+template<class Stage>
+static void runStage(Mat& OutResult, const Mat& InMat, float intensity) {
+	static thread_local Stage stage;
+	stage.prepare(InMat.rows, InMat.cols, intensity, frameSeed);
+	stage.processFrame(OutResult, InMat);
+}
+
+//Same for the stages with a planar version. Green passes through these effects unchanged.
+template<class Stage>
+static void runPlanarStage(PlanarFrame& OutResult, const PlanarFrame& InPlanes, float intensity) {
+	static thread_local Stage stage;
+	stage.prepare(InPlanes.getRows(), InPlanes.getCols(), intensity, frameSeed);
+	OutResult.create(InPlanes.getRows(), InPlanes.getCols());
+	OutResult.share(1, InPlanes);
+	stage.processPlanar(OutResult, InPlanes);
+}
+
+//Seperate rgb channel horizontally.
+template<int ShiftScale>
+class SplitRGB1Stage : public GlitchStage {
+
+	public:
+		void prepare(int rows, int cols, float intensity, uint64_t seed) override {
+			FrameRandom random(seed, RANDOM_SPLIT_RGB1);
+			this->cols = cols;
+			splitAmount = ShiftScale * pixelScale * intensity * random.uniform(0);
+		}
+
+		bool isRowLocal() const override { return true; }
+
+		void processRow(uchar* out, const uchar* in, int row) const override {
+			const uchar* src[3] = { in, in, in };
+			int shifts[3] = { splitAmount, 0, -splitAmount };
+			remapRow(out, src, shifts, cols, 0, cols);
+		}
+
+		void processPlanar(PlanarFrame& OutResult, const PlanarFrame& InPlanes) const {
+			forEachRow(*threadPool, InPlanes.getRows(), [&](int row) {
+				rotateRow(OutResult.plane(0).ptr(row), InPlanes.plane(0).ptr(row), cols, 0, cols, splitAmount);
+				rotateRow(OutResult.plane(2).ptr(row), InPlanes.plane(2).ptr(row), cols, 0, cols, -splitAmount);
+			});
+		}
+
+	private:
+		int cols = 0;
+		int splitAmount = 0;
+};
+
+//Seperate rgb channel both horizontally and vertically
+template<int ShiftScale>
+class SplitRGB2Stage : public GlitchStage {
+
+	public:
+		void prepare(int rows, int cols, float intensity, uint64_t seed) override {
+			FrameRandom random(seed, RANDOM_SPLIT_RGB2);
+			splitAmount = ShiftScale * pixelScale * intensity * random.uniform(0);
+		}
+
+		bool isRowLocal() const override { return false; }
+
+		void processFrame(Mat& OutResult, const Mat& InMat) const override {
+			forEachRow(*threadPool, InMat.rows, [&](int row) {
+				const uchar* shifted = InMat.ptr((row + splitAmount) % InMat.rows);
+				const uchar* src[3] = { shifted, InMat.ptr(row), shifted };
+				int shifts[3] = { splitAmount, 0, -splitAmount };
+				remapRow(OutResult.ptr(row), src, shifts, InMat.cols, 0, InMat.cols);
+			});
+		}
+
+		int getRowReach() const override { return splitAmount; }
+
+		void processStrip(Mat& OutStrip, const Mat& InWindow, int windowBegin, int rowBegin, int rowEnd, int frameRows) const override {
+			forEachRow(*threadPool, rowEnd - rowBegin, [&](int row) {
+				const uchar* shifted = InWindow.ptr(rowBegin + row + splitAmount - windowBegin);
+				const uchar* src[3] = { shifted, InWindow.ptr(rowBegin + row - windowBegin), shifted };
+				int shifts[3] = { splitAmount, 0, -splitAmount };
+				remapRow(OutStrip.ptr(row), src, shifts, InWindow.cols, 0, InWindow.cols);
+			});
+		}
+
+		void processPlanar(PlanarFrame& OutResult, const PlanarFrame& InPlanes) const {
+			int rows = InPlanes.getRows();
+			int cols = InPlanes.getCols();
+			forEachRow(*threadPool, rows, [&](int row) {
+				int shiftedRow = (row + splitAmount) % rows;
+				rotateRow(OutResult.plane(0).ptr(row), InPlanes.plane(0).ptr(shiftedRow), cols, 0, cols, splitAmount);
+				rotateRow(OutResult.plane(2).ptr(row), InPlanes.plane(2).ptr(shiftedRow), cols, 0, cols, -splitAmount);
+			});
+		}
+
+	private:
+		int splitAmount = 0;
+};
+
+//Each row takes a random offset to generate such an effect. Rows through moving tiles jump further.
+template<int ShiftScale>
+class ScanLineStage : public GlitchStage {
+
+	public:
+		ScanLineStage() : random(0, RANDOM_SCAN_LINE) {}
+
+		void prepare(int rows, int cols, float intensity, uint64_t seed) override {
+			random = FrameRandom(seed, RANDOM_SCAN_LINE);
+			this->cols = cols;
+			maxShift = ShiftScale * pixelScale;
+			bandIntensity.resize((rows + MotionMap::tileSize - 1) / MotionMap::tileSize);
+			for (size_t band = 0; band < bandIntensity.size(); band++) {
+				int rowBegin = int(band) * MotionMap::tileSize;
+				bandIntensity[band] = regionIntensity(intensity, rows, cols, rowBegin, rowBegin + MotionMap::tileSize, 0, cols);
+			}
+		}
+
+		bool isRowLocal() const override { return true; }
+
+		void processRow(uchar* out, const uchar* in, int row) const override {
+			float jitter = random.uniform(row);
+			int splitAmount = maxShift * bandIntensity[row / MotionMap::tileSize] * (jitter * 2 - 1);
+			shiftRow(out, in, cols, 0, cols, splitAmount);
+		}
+
+	private:
+		FrameRandom random;
+		int cols = 0;
+		float maxShift = 0;
+		//One intensity per row of motion tiles.
+		std::vector<float> bandIntensity;
+};
+
+//scanLine through time: each row also comes from an earlier frame, picked at random and further back where the
+//motion under it is stronger, so a moving person tears into rows of where they were. Needs a frame history,
+//without one it is a scanLine with its own random numbers.
+template<int ShiftScale>
+class TimeScanLineStage : public GlitchStage {
+
+	public:
+		TimeScanLineStage() : random(0, RANDOM_TIME_SCAN_LINE) {}
+
+		void prepare(int rows, int cols, float intensity, uint64_t seed) override {
+			random = FrameRandom(seed, RANDOM_TIME_SCAN_LINE);
+			this->cols = cols;
+			maxShift = ShiftScale * pixelScale;
+			bandIntensity.resize((rows + MotionMap::tileSize - 1) / MotionMap::tileSize);
+			for (size_t band = 0; band < bandIntensity.size(); band++) {
+				int rowBegin = int(band) * MotionMap::tileSize;
+				bandIntensity[band] = regionIntensity(intensity, rows, cols, rowBegin, rowBegin + MotionMap::tileSize, 0, cols);
+			}
+			collectPastFrames(past, rows, cols);
+		}
+
+		bool isRowLocal() const override { return true; }
+
+		void processRow(uchar* out, const uchar* in, int row) const override {
+			float band = bandIntensity[row / MotionMap::tileSize];
+			int splitAmount = maxShift * band * (random.uniform(2 * row) * 2 - 1);
+			//0 keeps the current frame's row.
+			int age = int((past.size() + 1) * band * random.uniform(2 * row + 1));
+			shiftRow(out, age > 0 ? past[age - 1]->ptr(row) : in, cols, 0, cols, splitAmount);
+		}
+
+	private:
+		FrameRandom random;
+		int cols = 0;
+		float maxShift = 0;
+		std::vector<float> bandIntensity;
+		std::vector<const Mat*> past;
+};
+
+//Each pixel takes a random two dimensional offset.
+template<int ShiftScale>
+class SandStage : public GlitchStage {
+
+	public:
+		SandStage() : random(0, RANDOM_SAND) {}
+
+		void prepare(int rows, int cols, float intensity, uint64_t seed) override {
+			random = FrameRandom(seed, RANDOM_SAND);
+			maxShift = ShiftScale * pixelScale * intensity;
+		}
+
+		bool isRowLocal() const override { return false; }
+
+		void processFrame(Mat& OutResult, const Mat& InMat) const override {
+			int rows = InMat.rows;
+			int cols = InMat.cols;
+			forEachPixel(*threadPool, rows, cols, [&](int row, int col) {
+				uint64_t j = uint64_t(row) * cols + col;
+				int splitAmountX = maxShift * (random.uniform(2 * j) * 2 - 1);
+				int splitAmountY = maxShift * (random.uniform(2 * j + 1) * 2 - 1);
+				//Shifts may exceed the size of a small frame, wrap around as often as needed.
+				int srcRow = ((row + splitAmountY) % rows + rows) % rows;
+				int srcCol = ((col + splitAmountX) % cols + cols) % cols;
+				const uchar* in = InMat.ptr(srcRow) + srcCol * 3;
+				uchar* out = OutResult.ptr(row) + col * 3;
+				out[0] = in[0];
+				out[1] = in[1];
+				out[2] = in[2];
+			});
+		}
+
+		int getRowReach() const override { return int(maxShift); }
+
+		//Same random numbers as processFrame, from the frame row. Rows come from the window unwrapped, it holds the
+		//wrapped rows already.
+		void processStrip(Mat& OutStrip, const Mat& InWindow, int windowBegin, int rowBegin, int rowEnd, int frameRows) const override {
+			int cols = InWindow.cols;
+			forEachPixel(*threadPool, rowEnd - rowBegin, cols, [&](int row, int col) {
+				uint64_t j = uint64_t(wrapRow(rowBegin + row, frameRows)) * cols + col;
+				int splitAmountX = maxShift * (random.uniform(2 * j) * 2 - 1);
+				int splitAmountY = maxShift * (random.uniform(2 * j + 1) * 2 - 1);
+				int srcCol = ((col + splitAmountX) % cols + cols) % cols;
+				const uchar* in = InWindow.ptr(rowBegin + row + splitAmountY - windowBegin) + srcCol * 3;
+				uchar* out = OutStrip.ptr(row) + col * 3;
+				out[0] = in[0];
+				out[1] = in[1];
+				out[2] = in[2];
+			});
+		}
+
+	private:
+		FrameRandom random;
+		float maxShift = 0;
+};
+
+//Each block takes a random rgb split value. With threshold set, blocks above intensity are left alone,
+//such that can generate random blocks. Every cell of the blockCount x blockCount grid shifts red and blue
+//by its noise value in opposite directions, the last row and column of cells take the remainder pixels.
+//Each cell takes the intensity of the motion under it, so blocks over a moving person glitch harder.
+//With freeze set the blocks that are on show an earlier frame of the history instead: a block holds on to one
+//frame for as many frames as the history has, then jumps to the newest one. Every block is at its own phase of
+//that cycle, so the frozen tiles do not all jump at once.
+template<bool Threshold, bool Freeze, int BlockCount, int ShiftScale>
+class BlockStage : public GlitchStage {
+
+	public:
+		void prepare(int rows, int cols, float intensity, uint64_t seed) override {
+			FrameRandom random(seed, Freeze ? RANDOM_FREEZE_BLOCK : Threshold ? RANDOM_BLOCK2 : RANDOM_BLOCK1);
+			this->cols = cols;
+			blockWidth = std::max(1, cols / blockCount);
+			blockHeight = std::max(1, rows / blockCount);
+			maxShift = ShiftScale * pixelScale;
+
+			for (int i = 0; i < blockCount * blockCount; i++) {
+				int rowBegin = i / blockCount * blockHeight;
+				int rowEnd = i / blockCount == blockCount - 1 ? rows : rowBegin + blockHeight;
+				int colBegin = i % blockCount * blockWidth;
+				int colEnd = i % blockCount == blockCount - 1 ? cols : colBegin + blockWidth;
+				blockIntensity[i] = regionIntensity(intensity, rows, cols, rowBegin, rowEnd, colBegin, colEnd);
+			}
+
+			randomNoise.create(blockCount, blockCount, CV_8UC1);
+			for (int i = 0; i < blockCount * blockCount; i++) {
+				if (Threshold) {
+					randomNoise.data[i] = random.uniform(2 * i) * 255;
+					if (random.uniform(2 * i + 1) > blockIntensity[i]) {
+						randomNoise.data[i] = 0;
+					}
+				}
+				else {
+					randomNoise.data[i] = random.uniform(i) * 255;
+				}
+			}
+
+			if (Freeze) {
+				collectPastFrames(past, rows, cols);
+				int frames = int(past.size());
+				//Index of the frame being processed, the history holds the ones right before it.
+				uint64_t current = frames > 0 ? frameHistory->get(1)->index + 1 : 0;
+				for (int i = 0; i < blockCount * blockCount; i++) {
+					//Age 1 to frames, one older every frame until it wraps around.
+					int age = frames > 0 ? int((current + mixRandom(i) % frames) % frames) + 1 : 0;
+					blockSource[i] = randomNoise.data[i] && age > 0 ? past[age - 1] : nullptr;
+				}
+			}
+		}
+
+		bool isRowLocal() const override { return true; }
+
+		void processRow(uchar* out, const uchar* in, int row) const override {
+			int blockRow = std::min(row / blockHeight, blockCount - 1);
+			const uchar* noiseRow = randomNoise.ptr(blockRow);
+			const float* intensityRow = blockIntensity + blockRow * blockCount;
+			const Mat* const* sourceRow = blockSource + blockRow * blockCount;
+			for (int block = 0; block < blockCount; block++) {
+				int dstBegin = block * blockWidth;
+				int dstEnd = block == blockCount - 1 ? cols : std::min(cols, dstBegin + blockWidth);
+				float random = noiseRow[block];
+				int splitAmount = maxShift * intensityRow[block] * random;
+				int shifts[3] = { splitAmount, 0, -splitAmount };
+				const uchar* blockIn = Freeze && sourceRow[block] ? sourceRow[block]->ptr(row) : in;
+				const uchar* src[3] = { blockIn, blockIn, blockIn };
+				remapRow(out, src, shifts, cols, dstBegin, dstEnd);
+			}
+		}
+
+		void processPlanar(PlanarFrame& OutResult, const PlanarFrame& InPlanes) const {
+			forEachRow(*threadPool, InPlanes.getRows(), [&](int row) {
+				int blockRow = std::min(row / blockHeight, blockCount - 1);
+				const uchar* noiseRow = randomNoise.ptr(blockRow);
+				const float* intensityRow = blockIntensity + blockRow * blockCount;
+				for (int block = 0; block < blockCount; block++) {
+					int dstBegin = block * blockWidth;
+					int dstEnd = block == blockCount - 1 ? cols : std::min(cols, dstBegin + blockWidth);
+					float random = noiseRow[block];
+					int splitAmount = maxShift * intensityRow[block] * random;
+					rotateRow(OutResult.plane(0).ptr(row), InPlanes.plane(0).ptr(row), cols, dstBegin, dstEnd, splitAmount);
+					rotateRow(OutResult.plane(2).ptr(row), InPlanes.plane(2).ptr(row), cols, dstBegin, dstEnd, -splitAmount);
+				}
+			});
+		}
+
+	private:
+		static const int blockCount = BlockCount;
+		int cols = 0;
+		int blockWidth = 1;
+		int blockHeight = 1;
+		float maxShift = 0;
+		float blockIntensity[blockCount * blockCount] = {};
+		Mat randomNoise;
+		//Freeze only: earlier frame of each block, nullptr for the current one.
+		std::vector<const Mat*> past;
+		const Mat* blockSource[blockCount * blockCount] = {};
+};
+
+//Random color noise rows applied to the merged result, one noise row per cluster of rowClusterNum rows.
+//Digital: merge and inverse where the noise is on. Intermidiate: the noise alone. There could be various visual effect.
+//The noise is cached across frames: a bank of run length encoded rows, of which each cluster shows one.
+//Every frame a share of the clusters, growing with intensity, switches to another bank row and a few bank rows
+//are generated anew, so the stripes flicker instead of being rebuilt. Each run is gated by the current intensity,
+//a still frame shows no stripes whatever is cached. The output depends on the frames before it.
+template<bool Inverse, int Clusters>
+class StripeStage : public GlitchStage {
+
+	public:
+		void prepare(int rows, int cols, float intensity, uint64_t seed) override {
+			FrameRandom random(seed, Inverse ? RANDOM_DIGITAL_STRIPE : RANDOM_INT_DIGITAL_STRIPE);
+			uint64_t counter = 0;
+			rowClusterNum = std::max(1, rows / Clusters);
+			gateLevel = int(intensity * 256);
+
+			//New size: fill the whole bank and give every cluster a row.
+			if (cols != this->cols || rows / rowClusterNum + 1 != int(clusterPattern.size())) {
+				this->cols = cols;
+				//Worst case, one pixel runs: a full bank of live rows, as many dead ones and a frame of new ones.
+				runs.clear();
+				runs.reserve(size_t(2 * bankSize + bankRefresh) * cols);
+				compacted.clear();
+				compacted.reserve(size_t(bankSize) * cols);
+				bank.assign(bankSize, Pattern());
+				for (int pattern = 0; pattern < bankSize; pattern++) {
+					generatePattern(pattern, intensity, random, counter);
+				}
+				clusterPattern.resize(rows / rowClusterNum + 1);
+				for (size_t cluster = 0; cluster < clusterPattern.size(); cluster++) {
+					clusterPattern[cluster] = random.bits(counter++) % bankSize;
+				}
+				return;
+			}
+
+			for (int i = 0; i < bankRefresh; i++) {
+				generatePattern(random.bits(counter++) % bankSize, intensity, random, counter);
+			}
+			for (size_t cluster = 0; cluster < clusterPattern.size(); cluster++) {
+				if (random.uniform(counter++) < intensity) {
+					clusterPattern[cluster] = random.bits(counter++) % bankSize;
+				}
+			}
+			//Regenerated rows are appended, drop the dead runs once they outweigh the live ones.
+			if (runs.size() > size_t(liveRuns()) * 2) {
+				compact();
+			}
+		}
+
+		bool isRowLocal() const override { return true; }
+
+		void processRow(uchar* out, const uchar* in, int row) const override {
+			const Pattern& pattern = bank[clusterPattern[row / rowClusterNum]];
+			int x = 0;
+			for (const Run* run = runs.data() + pattern.first; run != runs.data() + pattern.first + pattern.count; run++) {
+				int end = x + run->length;
+				if (run->gate >= gateLevel) {
+					if (Inverse) {
+						memcpy(out + x * 3, in + x * 3, size_t(run->length) * 3);
+					}
+					else {
+						memset(out + x * 3, 0, size_t(run->length) * 3);
+					}
+				}
+				else if (Inverse) {
+					for (; x < end; x++) {
+						out[x * 3] = 255 - (in[x * 3] * 0.5 + 0.5 * run->color[0]);
+						out[x * 3 + 1] = 255 - (in[x * 3 + 1] * 0.5 + 0.5 * run->color[1]);
+						out[x * 3 + 2] = 255 - (in[x * 3 + 2] * 0.5 + 0.5 * run->color[2]);
+					}
+				}
+				else {
+					uchar color[3] = { uchar(255 * run->color[0]), uchar(255 * run->color[1]), uchar(255 * run->color[2]) };
+					for (; x < end; x++) {
+						out[x * 3] = color[0];
+						out[x * 3 + 1] = color[1];
+						out[x * 3 + 2] = color[2];
+					}
+				}
+				x = end;
+			}
+		}
+
+	private:
+		//Pixels of one color, on where gate < intensity * 256.
+		struct Run {
+			int length;
+			uchar color[3];
+			uchar gate;
+		};
+
+		//Runs [first, first + count) of one bank row, covering cols pixels.
+		struct Pattern {
+			size_t first = 0;
+			int count = 0;
+		};
+
+		//Runs as long as a random share of (1 - intensity) of the width, like the noise image it replaces.
+		void generatePattern(int index, float intensity, const FrameRandom& random, uint64_t& counter) {
+			Pattern& pattern = bank[index];
+			pattern.first = runs.size();
+			pattern.count = 0;
+			for (int x = 0; x < cols;) {
+				Run run;
+				run.length = std::min(cols - x, std::max(1, int(random.uniform(counter++) * cols * (1 - intensity))));
+				run.color[0] = random.uniform(counter++) * 255;
+				run.color[1] = random.uniform(counter++) * 255;
+				run.color[2] = random.uniform(counter++) * 255;
+				run.gate = random.uniform(counter++) * 256;
+				runs.push_back(run);
+				pattern.count++;
+				x += run.length;
+			}
+		}
+
+		int liveRuns() const {
+			int count = 0;
+			for (auto& pattern : bank) {
+				count += pattern.count;
+			}
+			return count;
+		}
+
+		//Copied back rather than swapped, so that runs keeps the capacity reserved for it.
+		void compact() {
+			compacted.clear();
+			for (auto& pattern : bank) {
+				size_t first = compacted.size();
+				compacted.insert(compacted.end(), runs.begin() + pattern.first, runs.begin() + pattern.first + pattern.count);
+				pattern.first = first;
+			}
+			runs.assign(compacted.begin(), compacted.end());
+		}
+
+		static const int bankSize = 64;
+		//Bank rows generated again each frame.
+		static const int bankRefresh = 2;
+		int cols = 0;
+		int rowClusterNum = 1;
+		int gateLevel = 0;
+		std::vector<Run> runs;
+		std::vector<Run> compacted;
+		std::vector<Pattern> bank;
+		std::vector<int> clusterPattern;
+};
+
+//The effects as shipped, with their tuning.
+typedef SplitRGB1Stage<shiftScale> SplitRGB1Effect;
+typedef SplitRGB2Stage<shiftScale> SplitRGB2Effect;
+typedef ScanLineStage<shiftScale> ScanLineEffect;
+typedef SandStage<shiftScale> SandEffect;
+typedef BlockStage<false, false, blockCount, blockShiftScale> Block1Effect;
+typedef BlockStage<true, false, blockCount, blockShiftScale> Block2Effect;
+typedef StripeStage<true, digitalStripeClusters> DigitalStripeEffect;
+typedef StripeStage<false, intDigitalStripeClusters> IntDigitalStripeEffect;
+typedef TimeScanLineStage<shiftScale> TimeScanLineEffect;
+typedef BlockStage<true, true, blockCount, blockShiftScale> FreezeBlockEffect;
+
+//--------------------------------------------------------------
+void splitRGB1(Mat& OutResult, const Mat& InMat, float intensity) {
+	runStage<SplitRGB1Effect>(OutResult, InMat, intensity);
+}
+
+//--------------------------------------------------------------
+void splitRGB1Planar(PlanarFrame& OutResult, const PlanarFrame& InPlanes, float intensity) {
+	runPlanarStage<SplitRGB1Effect>(OutResult, InPlanes, intensity);
+}
+
+//--------------------------------------------------------------
+void splitRGB2(Mat& OutResult, const Mat& InMat, float intensity) {
+	runStage<SplitRGB2Effect>(OutResult, InMat, intensity);
+}
+
+//--------------------------------------------------------------
+void splitRGB2Planar(PlanarFrame& OutResult, const PlanarFrame& InPlanes, float intensity) {
+	runPlanarStage<SplitRGB2Effect>(OutResult, InPlanes, intensity);
+}
+
+//--------------------------------------------------------------
+void scanLine(Mat& OutResult, const Mat& InMat, float intensity) {
+	runStage<ScanLineEffect>(OutResult, InMat, intensity);
+}
+
+//--------------------------------------------------------------
+void sand(Mat& OutResult, const Mat& InMat, float intensity) {
+	runStage<SandEffect>(OutResult, InMat, intensity);
+}
+
+//--------------------------------------------------------------
+void block1(Mat& OutResult, const Mat& InMat, float intensity) {
+	runStage<Block1Effect>(OutResult, InMat, intensity);
+}
+
+//--------------------------------------------------------------
+void block1Planar(PlanarFrame& OutResult, const PlanarFrame& InPlanes, float intensity) {
+	runPlanarStage<Block1Effect>(OutResult, InPlanes, intensity);
+}
+
+//--------------------------------------------------------------
+void block2(Mat& OutResult, const Mat& InMat, float intensity) {
+	runStage<Block2Effect>(OutResult, InMat, intensity);
+}
+
+//--------------------------------------------------------------
+void block2Planar(PlanarFrame& OutResult, const PlanarFrame& InPlanes, float intensity) {
+	runPlanarStage<Block2Effect>(OutResult, InPlanes, intensity);
+}
+
+//--------------------------------------------------------------
+void intDigitalStripe(Mat& OutResult, const Mat& InMat, float intensity) {
+	runStage<IntDigitalStripeEffect>(OutResult, InMat, intensity);
+}
+
+//--------------------------------------------------------------
+void digitalStripe(Mat& OutResult, const Mat& InMat, float intensity) {
+	runStage<DigitalStripeEffect>(OutResult, InMat, intensity);
+}
+
+//--------------------------------------------------------------
+void timeScanLine(Mat& OutResult, const Mat& InMat, float intensity) {
+	runStage<TimeScanLineEffect>(OutResult, InMat, intensity);
+}
+
+//--------------------------------------------------------------
+void freezeBlock(Mat& OutResult, const Mat& InMat, float intensity) {
+	runStage<FreezeBlockEffect>(OutResult, InMat, intensity);
+}
+
+//--------------------------------------------------------------
+template<class Stage>
+static std::unique_ptr<GlitchStage> createStage() {
+	return std::unique_ptr<GlitchStage>(new Stage());
+}
+
+//--------------------------------------------------------------
+const std::vector<PostprocessEntry>& getPostprocessList() {
+	static const std::vector<PostprocessEntry> list = {
+		{ "splitRGB1", splitRGB1, createStage<SplitRGB1Effect>, splitRGB1Planar },
+		{ "splitRGB2", splitRGB2, createStage<SplitRGB2Effect>, splitRGB2Planar },
+		{ "scanLine", scanLine, createStage<ScanLineEffect>, nullptr },
+		{ "sand", sand, createStage<SandEffect>, nullptr },
+		{ "block1", block1, createStage<Block1Effect>, block1Planar },
+		{ "block2", block2, createStage<Block2Effect>, block2Planar },
+		{ "digitalStripe", digitalStripe, createStage<DigitalStripeEffect>, nullptr },
+		{ "intDigitalStripe", intDigitalStripe, createStage<IntDigitalStripeEffect>, nullptr },
+		{ "timeScanLine", timeScanLine, createStage<TimeScanLineEffect>, nullptr },
+		{ "freezeBlock", freezeBlock, createStage<FreezeBlockEffect>, nullptr },
+	};
+	return list;
+}
+
+//--------------------------------------------------------------
+const PostprocessEntry* findPostprocessEntry(const std::string& name) {
+	for (auto& entry : getPostprocessList()) {
+		if (name == entry.name) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+//--------------------------------------------------------------
+const PostprocessEntry* findPostprocessEntry(PostprocessFunc func) {
+	for (auto& entry : getPostprocessList()) {
+		if (func == entry.func) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+//--------------------------------------------------------------
+PostprocessFunc findPostprocess(const std::string& name) {
+	const PostprocessEntry* entry = findPostprocessEntry(name);
+	return entry ? entry->func : nullptr;
+}
+
+//Otsu's method on a 256 bin histogram, the same level cv::threshold picks with THRESH_OTSU.
+static int otsuThreshold(const uint32_t* histogram, uint64_t total) {
+	double scale = 1.0 / double(total);
+	double mu = 0;
+	for (int i = 0; i < 256; i++) {
+		mu += i * double(histogram[i]);
+	}
+	mu *= scale;
+
+	double q1 = 0;
+	double mu1 = 0;
+	double maxSigma = 0;
+	int level = 0;
+	for (int i = 0; i < 256; i++) {
+		double p = histogram[i] * scale;
+		mu1 *= q1;
+		q1 += p;
+		double q2 = 1 - q1;
+		if (std::min(q1, q2) < FLT_EPSILON || std::max(q1, q2) > 1 - FLT_EPSILON) {
+			continue;
+		}
+		mu1 = (mu1 + i * p) / q1;
+		double mu2 = (mu - q1 * mu1) / q2;
+		double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+		if (sigma > maxSigma) {
+			maxSigma = sigma;
+			level = i;
+		}
+	}
+	return level;
+}
+
+//--------------------------------------------------------------
+float analyzeMask(Mat& OutMask, MotionMap& OutMotion, Mat& InOutMaskPre, const Mat& InCam, int scale) {
+
+	OutMotion.reset(InCam.rows, InCam.cols, scale);
+	scale = OutMotion.getScale();
+	OutMask.create(OutMotion.getMaskRows(), OutMotion.getMaskCols(), CV_8UC1);
+	bool firstFrame = InOutMaskPre.rows != OutMask.rows || InOutMaskPre.cols != OutMask.cols;
+	if (firstFrame) {
+		InOutMaskPre.create(OutMask.rows, OutMask.cols, CV_8UC1);
+	}
+
+	//Sweep 1: gray with the fixed-point weights of cvtColor RGB2GRAY, every scale-th pixel of every scale-th row,
+	//and its histogram. Each task fills its own histogram and adds it once.
+	uint32_t histogram[256] = {};
+	std::mutex histogramMutex;
+	{
+		PROFILE_SCOPE("gray + histogram");
+		threadPool->parallelFor(0, OutMask.rows, 0, [&](int rowBegin, int rowEnd) {
+			uint32_t localHistogram[256] = {};
+			for (int row = rowBegin; row < rowEnd; row++) {
+				const uchar* cam = InCam.ptr(row * scale);
+				uchar* gray = OutMask.ptr(row);
+				for (int col = 0; col < OutMask.cols; col++) {
+					const uchar* pixel = cam + col * scale * 3;
+					gray[col] = (pixel[0] * 4899 + pixel[1] * 9617 + pixel[2] * 1868 + (1 << 13)) >> 14;
+					localHistogram[gray[col]]++;
+				}
+			}
+			std::lock_guard<std::mutex> lock(histogramMutex);
+			for (int i = 0; i < 256; i++) {
+				histogram[i] += localHistogram[i];
+			}
+		});
+	}
+	int level = otsuThreshold(histogram, uint64_t(OutMask.rows) * OutMask.cols);
+
+	//Sweep 2: binarize in place, diff against the previous mask and update it. Each task owns whole rows of
+	//tiles and sums a tile in a local before storing it, nothing is shared between workers.
+	PROFILE_SCOPE("binarize + diff");
+	threadPool->parallelFor(0, OutMotion.getTileRows(), 1, [&](int tileRowBegin, int tileRowEnd) {
+		for (int tileRow = tileRowBegin; tileRow < tileRowEnd; tileRow++) {
+			uint32_t* counts = OutMotion.getTileRow(tileRow);
+			int rowBegin = tileRow * MotionMap::tileSize;
+			int rowEnd = std::min(OutMask.rows, rowBegin + MotionMap::tileSize);
+			for (int row = rowBegin; row < rowEnd; row++) {
+				uchar* mask = OutMask.ptr(row);
+				uchar* maskPre = InOutMaskPre.ptr(row);
+				for (int tileCol = 0; tileCol < OutMotion.getTileCols(); tileCol++) {
+					int colBegin = tileCol * MotionMap::tileSize;
+					int colEnd = std::min(OutMask.cols, colBegin + MotionMap::tileSize);
+					uint32_t changed = 0;
+					for (int col = colBegin; col < colEnd; col++) {
+						uchar value = mask[col] > level ? 255 : 0;
+						mask[col] = value;
+						changed += value != maskPre[col];
+						maskPre[col] = value;
+					}
+					//The first frame only fills the previous mask.
+					counts[tileCol] += firstFrame ? 0 : changed;
+				}
+			}
+		}
+	});
+	OutMotion.finish();
+
+	return OutMotion.getFrameFraction();
+}
+
+//--------------------------------------------------------------
+void blendFrame(Mat& OutMerge, const Mat& InImg, const Mat& InCam, float alphaCam) {
+	PROFILE_SCOPE("blend");
+
+	//The blend runs on whole rows with a fixed-point weight, see Blend.h.
+	BlendRowFunc blendRow = getBestBlendRow();
+	int weight = blendWeight(alphaCam);
+	threadPool->parallelFor(0, InImg.rows, 0, [&](int rowBegin, int rowEnd) {
+		for (int row = rowBegin; row < rowEnd; row++) {
+			blendRow(OutMerge.ptr(row), InImg.ptr(row), InCam.ptr(row), InImg.cols * 3, weight);
+		}
+	});
+}
+
+//Pixels are split into planes in registers and blended there, see Blend.h.
+void blendFramePlanar(PlanarFrame& OutMerge, const Mat& InImg, const Mat& InCam, float alphaCam) {
+	PROFILE_SCOPE("blend planar");
+	BlendPlanarRowFunc blendRow = getBestBlendPlanarRow();
+	int weight = blendWeight(alphaCam);
+	OutMerge.create(InImg.rows, InImg.cols);
+	threadPool->parallelFor(0, InImg.rows, 0, [&](int rowBegin, int rowEnd) {
+		for (int row = rowBegin; row < rowEnd; row++) {
+			blendRow(OutMerge.plane(0).ptr(row), OutMerge.plane(1).ptr(row), OutMerge.plane(2).ptr(row), InImg.ptr(row), InCam.ptr(row), InImg.cols, weight);
+		}
+	});
+}
+
+//--------------------------------------------------------------
+float mergeFrame(Mat& OutMerge, Mat& OutMask, MotionMap& OutMotion, Mat& InOutMaskPre, const Mat& InImg, const Mat& InCam, float alphaCam, int maskScale) {
+	float intensity = analyzeMask(OutMask, OutMotion, InOutMaskPre, InCam, maskScale);
+	blendFrame(OutMerge, InImg, InCam, alphaCam);
+	return intensity;
+}
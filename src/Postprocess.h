@@ -0,0 +1,123 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include "MotionMap.h"
+#include "PlanarFrame.h"
+#include "FrameHistory.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+//All postprocess functions share this signature: (result, merged input, motion intensity in [0, 1]).
+typedef void (*PostprocessFunc)(cv::Mat&, const cv::Mat&, float);
+
+//Declaration of processing funtions
+#define DECLARE_POSTPROCESS(func) void func(cv::Mat&, const cv::Mat&, float)
+DECLARE_POSTPROCESS(splitRGB1);
+DECLARE_POSTPROCESS(splitRGB2);
+DECLARE_POSTPROCESS(block1);
+DECLARE_POSTPROCESS(block2);
+DECLARE_POSTPROCESS(sand);
+DECLARE_POSTPROCESS(scanLine);
+DECLARE_POSTPROCESS(digitalStripe);
+DECLARE_POSTPROCESS(intDigitalStripe);
+DECLARE_POSTPROCESS(timeScanLine);
+DECLARE_POSTPROCESS(freezeBlock);
+
+//Planar versions of the effects that only move red and blue, same output as the interleaved ones.
+//The result shares its green plane with the input.
+typedef void (*PlanarPostprocessFunc)(PlanarFrame&, const PlanarFrame&, float);
+#define DECLARE_PLANAR_POSTPROCESS(func) void func(PlanarFrame&, const PlanarFrame&, float)
+DECLARE_PLANAR_POSTPROCESS(splitRGB1Planar);
+DECLARE_PLANAR_POSTPROCESS(splitRGB2Planar);
+DECLARE_PLANAR_POSTPROCESS(block1Planar);
+DECLARE_PLANAR_POSTPROCESS(block2Planar);
+
+//A postprocess split into its per frame setup and its per row work, so that several of them can be chained.
+//Row local stages only read input row r to write output row r (any horizontal offset), they can run tile by tile.
+//The others, with vertical jumps like splitRGB2 and sand, need the whole input frame.
+class GlitchStage {
+
+	public:
+		virtual ~GlitchStage() {}
+
+		//Called once per frame on the calling thread, before any row. Draws all random numbers from seed.
+		virtual void prepare(int rows, int cols, float intensity, uint64_t seed) = 0;
+
+		virtual bool isRowLocal() const = 0;
+
+		//Row local stages: output row `row` from the matching input row. Safe to call from any thread.
+		virtual void processRow(uchar* out, const uchar* in, int row) const {}
+
+		//Whole frame on the pool. The default runs processRow on bands of rows.
+		virtual void processFrame(cv::Mat& OutResult, const cv::Mat& InMat) const;
+
+		//Rows above and below an output row the stage may read, after prepare(). 0 for row local stages.
+		virtual int getRowReach() const { return 0; }
+
+		//Rows [rowBegin, rowEnd) of a frameRows high frame into OutStrip, for frames too large to hold (see StillRenderer).
+		//Row r of the frame is row r - windowBegin of InWindow, rows past either edge are the wrapped around rows of
+		//the other edge as processFrame reads them, so rowBegin may be negative. InWindow covers
+		//[rowBegin - getRowReach(), rowEnd + getRowReach()). The default runs processRow.
+		virtual void processStrip(cv::Mat& OutStrip, const cv::Mat& InWindow, int windowBegin, int rowBegin, int rowEnd, int frameRows) const;
+};
+
+struct PostprocessEntry {
+	const char* name;
+	PostprocessFunc func;
+	std::unique_ptr<GlitchStage> (*createStage)();
+	//nullptr when the effect has no planar version.
+	PlanarPostprocessFunc planar;
+};
+
+//Pool every pass runs on. Must be set before the first frame.
+void setPostprocessPool(ThreadPool* pool);
+ThreadPool& getPostprocessPool();
+
+//Seed every random number of the next frame derives from, set once per frame by whoever drives the frames.
+//The same seed, input and intensity give the same output for any pool size.
+//The seed, the motion map, the frame history and the pixel scale are per thread: they apply to the postprocess
+//calls of the thread that set them, so several streams can each glitch on their own thread.
+void setFrameSeed(uint64_t seed);
+uint64_t getFrameSeed();
+
+//Motion of the frame being processed, set with the seed. block1/2 and scanLine scale their intensity by it per region,
+//nullptr or a map of another size gives the frame intensity everywhere. Must outlive the postprocess call.
+void setMotionMap(const MotionMap* motion);
+const MotionMap* getMotionMap();
+
+//Earlier merged frames of the stream, set with the seed. timeScanLine and freezeBlock pull rows and blocks from them,
+//without a history (or with frames of another size) they only have the current frame. Earlier frames are the merged
+//input, before any effect. Must outlive the postprocess call.
+void setFrameHistory(const FrameHistory* history);
+const FrameHistory* getFrameHistory();
+
+//Processing size over the size the effects were tuned for (the background), 1 by default. Pixel offsets shrink
+//with it so that a frame processed smaller and scaled up for display looks the same.
+void setPixelScale(float scale);
+float getPixelScale();
+
+//Every effect by name, in GUI order. findPostprocess returns nullptr for unknown names.
+const std::vector<PostprocessEntry>& getPostprocessList();
+PostprocessFunc findPostprocess(const std::string& name);
+const PostprocessEntry* findPostprocessEntry(const std::string& name);
+const PostprocessEntry* findPostprocessEntry(PostprocessFunc func);
+
+//Binarizes the camera into OutMask, counts the mask pixels that changed since InOutMaskPre per tile of OutMotion
+//and updates InOutMaskPre. Returns the fraction of changed pixels over the whole frame.
+//Two sweeps over the camera: gray and histogram, then Otsu binarize, diff and update in one go.
+//With scale > 1 the mask is 1 / scale of the camera size on each side, it only drives the intensity.
+float analyzeMask(cv::Mat& OutMask, MotionMap& OutMotion, cv::Mat& InOutMaskPre, const cv::Mat& InCam, int scale = 1);
+
+//OutMerge = InImg * (1 - alphaCam) + InCam * alphaCam.
+void blendFrame(cv::Mat& OutMerge, const cv::Mat& InImg, const cv::Mat& InCam, float alphaCam);
+
+//Same blend written as planes, for the planar effects.
+void blendFramePlanar(PlanarFrame& OutMerge, const cv::Mat& InImg, const cv::Mat& InCam, float alphaCam);
+
+//Both of the above: blends InCam over InImg into OutMerge, binarizes the camera into OutMask, fills OutMotion and
+//returns the fraction of mask pixels that changed since InOutMaskPre, which is updated.
+float mergeFrame(cv::Mat& OutMerge, cv::Mat& OutMask, MotionMap& OutMotion, cv::Mat& InOutMaskPre, const cv::Mat& InImg, const cv::Mat& InCam, float alphaCam, int maskScale = 1);
@@ -0,0 +1,306 @@
+#include "Profiler.h"
+
+#ifdef GLITCH_PROFILE
+
+#include "RollingStats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+struct ProfileEvent {
+	const char* name;
+	const char* parent;
+	int64_t start;
+	int64_t end;
+	int begin;
+	int rowEnd;
+	int depth;
+};
+
+//Single producer (its thread), single consumer (the main thread in profileFrame). Events [tail, head) are pending.
+struct ThreadLog {
+	static const size_t capacity = 1 << 14;
+
+	std::vector<ProfileEvent> events;
+	std::atomic<uint64_t> head{ 0 };
+	std::atomic<uint64_t> tail{ 0 };
+	std::atomic<bool> alive{ true };
+	int id = 0;
+
+	//Registry mutex.
+	std::string name;
+
+	//Owner thread only.
+	const char* zone = nullptr;
+	int depth = 0;
+
+	//Main thread only.
+	int64_t busy = 0;
+	RollingStats utilization;
+};
+
+//Marks the log of an exited thread, which keeps its place in the registry but leaves the overlay.
+struct ThreadLogHandle {
+	ThreadLog* log = nullptr;
+	~ThreadLogHandle() {
+		if (log) {
+			log->alive = false;
+		}
+	}
+};
+
+struct Zone {
+	const char* name;
+	RollingStats durations;
+	RollingStats calls;
+	int frameCalls = 0;
+};
+
+struct TraceEvent {
+	ProfileEvent event;
+	int thread;
+};
+
+}
+
+//Off until the "Profiler" toggle or a trace turns it on, the headless modes never do.
+static std::atomic<bool> enabled{ false };
+static std::atomic<uint64_t> droppedCount{ 0 };
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+//Logs are never freed, a thread that exits leaves its log behind.
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<ThreadLog>> threadLogs;
+static thread_local ThreadLogHandle currentLog;
+
+//Main thread only.
+static std::vector<Zone> zones;
+static int64_t lastFrame = -1;
+static std::vector<TraceEvent> traceEvents;
+static std::vector<int64_t> traceFrames;
+static int traceFramesLeft = 0;
+static std::string tracePath;
+
+//--------------------------------------------------------------
+static int64_t now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+//First use on a thread registers its log, the only allocation the profiler makes outside the main thread.
+static ThreadLog& getThreadLog() {
+	if (!currentLog.log) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		threadLogs.emplace_back(new ThreadLog());
+		ThreadLog& log = *threadLogs.back();
+		log.events.resize(ThreadLog::capacity);
+		log.id = int(threadLogs.size());
+		log.name = "thread " + std::to_string(log.id);
+		currentLog.log = &log;
+	}
+	return *currentLog.log;
+}
+
+//--------------------------------------------------------------
+void setProfileThreadName(const std::string& name) {
+	ThreadLog& log = getThreadLog();
+	std::lock_guard<std::mutex> lock(registryMutex);
+	log.name = name;
+}
+
+//--------------------------------------------------------------
+void setProfilingEnabled(bool enable) {
+	enabled = enable;
+}
+
+//--------------------------------------------------------------
+bool isProfilingEnabled() {
+	return enabled.load(std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+const char* getProfileZone() {
+	return currentLog.log ? currentLog.log->zone : nullptr;
+}
+
+//--------------------------------------------------------------
+int64_t beginProfileZone(const char* name) {
+	ThreadLog& log = getThreadLog();
+	log.zone = name;
+	log.depth++;
+	return now();
+}
+
+//--------------------------------------------------------------
+void endProfileZone(const char* name, const char* parent, int64_t start, int begin, int end) {
+	int64_t stop = now();
+	ThreadLog& log = getThreadLog();
+	log.depth--;
+	//Pool tasks name the zone that queued them as parent, which is not open on a worker.
+	log.zone = log.depth > 0 ? parent : nullptr;
+
+	uint64_t head = log.head.load(std::memory_order_relaxed);
+	if (head - log.tail.load(std::memory_order_acquire) >= ThreadLog::capacity) {
+		droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	log.events[head & (ThreadLog::capacity - 1)] = { name, parent, start, stop, begin, end, log.depth };
+	log.head.store(head + 1, std::memory_order_release);
+}
+
+//--------------------------------------------------------------
+static Zone& findZone(const char* name) {
+	//The same literal may have a different address in another translation unit.
+	for (auto& zone : zones) {
+		if (zone.name == name || std::strcmp(zone.name, name) == 0) {
+			return zone;
+		}
+	}
+	zones.emplace_back();
+	zones.back().name = name;
+	return zones.back();
+}
+
+//--------------------------------------------------------------
+static void writeTrace() {
+	std::ofstream file(tracePath);
+	if (!file) {
+		std::cerr << "cannot write " << tracePath << "\n";
+		return;
+	}
+	int64_t origin = traceFrames.empty() ? 0 : traceFrames.front();
+	auto micros = [origin](int64_t nanos) { return double(nanos - origin) * 1e-3; };
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	auto separate = [&]() {
+		file << (first ? "" : ",\n");
+		first = false;
+	};
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (auto& log : threadLogs) {
+			separate();
+			file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << log->id <<
+				",\"args\":{\"name\":\"" << log->name << "\"}}";
+		}
+	}
+	for (int64_t frame : traceFrames) {
+		separate();
+		file << "{\"name\":\"frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":" << micros(frame) << "}";
+	}
+	for (auto& trace : traceEvents) {
+		const ProfileEvent& event = trace.event;
+		separate();
+		file << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace.thread <<
+			",\"ts\":" << micros(event.start) << ",\"dur\":" << double(event.end - event.start) * 1e-3;
+		if (event.parent || event.begin != event.rowEnd) {
+			file << ",\"args\":{\"parent\":\"" << (event.parent ? event.parent : "") << "\"";
+			if (event.begin != event.rowEnd) {
+				file << ",\"begin\":" << event.begin << ",\"end\":" << event.rowEnd;
+			}
+			file << "}";
+		}
+		file << "}";
+	}
+	file << "\n]}\n";
+}
+
+//--------------------------------------------------------------
+void profileFrame() {
+	int64_t frame = now();
+	bool tracing = traceFramesLeft > 0;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (auto& log : threadLogs) {
+			uint64_t tail = log->tail.load(std::memory_order_relaxed);
+			uint64_t head = log->head.load(std::memory_order_acquire);
+			for (uint64_t i = tail; i < head; i++) {
+				const ProfileEvent& event = log->events[i & (ThreadLog::capacity - 1)];
+				Zone& zone = findZone(event.name);
+				zone.durations.add((event.end - event.start) * 1e-9);
+				zone.frameCalls++;
+				if (event.depth == 0) {
+					log->busy += event.end - event.start;
+				}
+				if (tracing) {
+					traceEvents.push_back({ event, log->id });
+				}
+			}
+			log->tail.store(head, std::memory_order_release);
+
+			if (lastFrame >= 0 && frame > lastFrame) {
+				log->utilization.add(std::min(1.0, double(log->busy) / double(frame - lastFrame)));
+			}
+			log->busy = 0;
+		}
+	}
+	for (auto& zone : zones) {
+		zone.calls.add(zone.frameCalls);
+		zone.frameCalls = 0;
+	}
+	lastFrame = frame;
+
+	if (tracing) {
+		traceFrames.push_back(frame);
+		if (--traceFramesLeft == 0) {
+			writeTrace();
+			traceEvents.clear();
+			traceFrames.clear();
+		}
+	}
+}
+
+//--------------------------------------------------------------
+std::vector<ProfileZoneStats> getProfileZoneStats() {
+	std::vector<ProfileZoneStats> stats;
+	for (auto& zone : zones) {
+		stats.push_back({ zone.name, zone.durations.mean() * 1e3, zone.durations.percentile(0.99) * 1e3, zone.calls.mean() });
+	}
+	return stats;
+}
+
+//--------------------------------------------------------------
+std::vector<ProfileThreadStats> getProfileThreadStats() {
+	std::vector<ProfileThreadStats> stats;
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (auto& log : threadLogs) {
+		if (log->alive) {
+			stats.push_back({ log->name, log->utilization.mean() });
+		}
+	}
+	return stats;
+}
+
+//--------------------------------------------------------------
+uint64_t getProfileDroppedCount() {
+	return droppedCount;
+}
+
+//--------------------------------------------------------------
+bool startProfileTrace(int frames, const std::string& path) {
+	if (traceFramesLeft > 0 || frames <= 0) {
+		return false;
+	}
+	//Events recorded before this call belong to the previous frame.
+	profileFrame();
+	traceEvents.clear();
+	traceFrames.assign(1, lastFrame);
+	traceFramesLeft = frames;
+	tracePath = path;
+	return true;
+}
+
+//--------------------------------------------------------------
+bool isProfileTraceRunning() {
+	return traceFramesLeft > 0;
+}
+
+#endif
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Scoped timings of the frame path. Every thread records its zones into its own ring, which the main thread drains
+//once per drawn frame (profileFrame) into rolling per zone stats and per thread utilization, and optionally into a
+//Chrome trace_event JSON file (chrome://tracing, ui.perfetto.dev).
+//Recording a zone costs two clock reads and a ring write, a flag check once profiling is switched off at run time.
+//Building with GLITCH_NO_PROFILE compiles every zone out.
+#ifndef GLITCH_NO_PROFILE
+#define GLITCH_PROFILE
+#endif
+
+#define GLITCH_PROFILE_CONCAT2(a, b) a##b
+#define GLITCH_PROFILE_CONCAT(a, b) GLITCH_PROFILE_CONCAT2(a, b)
+
+struct ProfileZoneStats {
+	const char* name;
+	//Per call.
+	double meanMs;
+	double p99Ms;
+	//Calls per drawn frame.
+	double calls;
+};
+
+struct ProfileThreadStats {
+	std::string name;
+	//Share of the wall time spent in top level zones, over the last drawn frames.
+	double utilization;
+};
+
+#ifdef GLITCH_PROFILE
+
+//Zone names must live as long as the program (literals, effect names), only the pointer is recorded.
+#define PROFILE_SCOPE(name) ProfileScope GLITCH_PROFILE_CONCAT(profileScope, __LINE__)(name)
+//Zone over the rows [begin, end), shown in the trace.
+#define PROFILE_RANGE(name, begin, end) ProfileScope GLITCH_PROFILE_CONCAT(profileScope, __LINE__)(name, begin, end)
+//Pool task over [begin, end), queued from inside the zone parent (see getProfileZone).
+#define PROFILE_TASK(parent, begin, end) ProfileScope GLITCH_PROFILE_CONCAT(profileScope, __LINE__)("pool task", begin, end, parent)
+
+//Name of the calling thread in the overlay and the trace. Copied.
+void setProfileThreadName(const std::string& name);
+
+void setProfilingEnabled(bool enabled);
+bool isProfilingEnabled();
+
+//Innermost zone open on the calling thread, nullptr outside any. Pool tasks are tagged with it.
+const char* getProfileZone();
+
+//Main thread, once per drawn frame: drains every thread and advances a running trace.
+void profileFrame();
+
+//Main thread. Stats as of the last profileFrame, zones in first seen order.
+std::vector<ProfileZoneStats> getProfileZoneStats();
+std::vector<ProfileThreadStats> getProfileThreadStats();
+//Zones lost because a ring was full, the main thread did not drain it in time.
+uint64_t getProfileDroppedCount();
+
+//Main thread. Records the next `frames` drawn frames and writes them to path, returns false if a trace is running.
+bool startProfileTrace(int frames, const std::string& path);
+bool isProfileTraceRunning();
+
+//Used through PROFILE_SCOPE and PROFILE_RANGE.
+int64_t beginProfileZone(const char* name);
+void endProfileZone(const char* name, const char* parent, int64_t start, int begin, int end);
+
+class ProfileScope {
+
+	public:
+		ProfileScope(const char* name, int begin = 0, int end = 0) : name(isProfilingEnabled() ? name : nullptr), begin(begin), end(end) {
+			if (this->name) {
+				parent = getProfileZone();
+				start = beginProfileZone(this->name);
+			}
+		}
+
+		ProfileScope(const char* name, int begin, int end, const char* parent) : name(isProfilingEnabled() ? name : nullptr), parent(parent), begin(begin), end(end) {
+			if (this->name) {
+				start = beginProfileZone(this->name);
+			}
+		}
+
+		~ProfileScope() {
+			if (name) {
+				endProfileZone(name, parent, start, begin, end);
+			}
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		const char* name;
+		const char* parent = nullptr;
+		int64_t start = 0;
+		int begin;
+		int end;
+};
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_RANGE(name, begin, end)
+#define PROFILE_TASK(parent, begin, end)
+
+inline void setProfileThreadName(const std::string& name) {}
+inline void setProfilingEnabled(bool enabled) {}
+inline bool isProfilingEnabled() { return false; }
+inline const char* getProfileZone() { return nullptr; }
+inline void profileFrame() {}
+inline std::vector<ProfileZoneStats> getProfileZoneStats() { return std::vector<ProfileZoneStats>(); }
+inline std::vector<ProfileThreadStats> getProfileThreadStats() { return std::vector<ProfileThreadStats>(); }
+inline uint64_t getProfileDroppedCount() { return 0; }
+inline bool startProfileTrace(int frames, const std::string& path) { return false; }
+inline bool isProfileTraceRunning() { return false; }
+
+#endif
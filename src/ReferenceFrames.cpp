@@ -0,0 +1,319 @@
+#include "ReferenceFrames.h"
+#include "GlitchRandom.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace cv;
+
+namespace {
+
+//Motion tiles, the same size as MotionMap's.
+const int referenceTile = 32;
+
+//--------------------------------------------------------------
+int wrap(int value, int size) {
+	return ((value % size) + size) % size;
+}
+
+//--------------------------------------------------------------
+const uchar* pixel(const Mat& mat, int row, int col) {
+	return mat.ptr(row) + col * mat.channels();
+}
+
+//--------------------------------------------------------------
+uchar* pixel(Mat& mat, int row, int col) {
+	return mat.ptr(row) + col * mat.channels();
+}
+
+//img * (1 - alpha) + cam * alpha with alpha as weight / 256, truncated.
+Mat blend(const Mat& InImg, const Mat& InCam, float alpha) {
+	int weight = std::min(256, std::max(0, int(alpha * 256 + 0.5f)));
+	Mat matOut(InImg.rows, InImg.cols, CV_8UC3);
+	for (int row = 0; row < InImg.rows; row++) {
+		for (int i = 0; i < InImg.cols * 3; i++) {
+			matOut.ptr(row)[i] = uchar((InImg.ptr(row)[i] * (256 - weight) + InCam.ptr(row)[i] * weight) >> 8);
+		}
+	}
+	return matOut;
+}
+
+//RGB2GRAY weights on every scale-th pixel, then the Otsu level by brute force: the one maximizing the between
+//class variance, the first one on ties. Above the level is 255.
+Mat mask(const Mat& InCam, int scale) {
+	Mat matGray((InCam.rows + scale - 1) / scale, (InCam.cols + scale - 1) / scale, CV_8UC1);
+	double histogram[256] = {};
+	for (int row = 0; row < matGray.rows; row++) {
+		for (int col = 0; col < matGray.cols; col++) {
+			const uchar* in = pixel(InCam, row * scale, col * scale);
+			uchar gray = uchar((in[0] * 4899 + in[1] * 9617 + in[2] * 1868 + (1 << 13)) >> 14);
+			matGray.ptr(row)[col] = gray;
+			histogram[gray]++;
+		}
+	}
+
+	double total = double(matGray.rows) * matGray.cols;
+	double best = 0;
+	int level = 0;
+	for (int threshold = 0; threshold < 256; threshold++) {
+		double count0 = 0, sum0 = 0, count1 = 0, sum1 = 0;
+		for (int i = 0; i <= threshold; i++) {
+			count0 += histogram[i];
+			sum0 += i * histogram[i];
+		}
+		for (int i = threshold + 1; i < 256; i++) {
+			count1 += histogram[i];
+			sum1 += i * histogram[i];
+		}
+		if (count0 == 0 || count1 == 0) {
+			continue;
+		}
+		double mean0 = sum0 / count0;
+		double mean1 = sum1 / count1;
+		double variance = (count0 / total) * (count1 / total) * (mean0 - mean1) * (mean0 - mean1);
+		if (variance > best * (1 + 1e-12)) {
+			best = variance;
+			level = threshold;
+		}
+	}
+	for (int row = 0; row < matGray.rows; row++) {
+		for (int col = 0; col < matGray.cols; col++) {
+			matGray.ptr(row)[col] = matGray.ptr(row)[col] > level ? 255 : 0;
+		}
+	}
+	return matGray;
+}
+
+//Changed mask pixels per tile between two masks of one size.
+struct Motion {
+	int rows = 0;
+	int cols = 0;
+	int tileRows = 0;
+	int tileCols = 0;
+	std::vector<uint32_t> counts;
+	uint64_t changed = 0;
+
+	Motion(const Mat& InMaskPre, const Mat& InMask) : rows(InMask.rows), cols(InMask.cols) {
+		tileRows = (rows + referenceTile - 1) / referenceTile;
+		tileCols = (cols + referenceTile - 1) / referenceTile;
+		counts.assign(size_t(tileRows) * tileCols, 0);
+		for (int row = 0; row < rows; row++) {
+			for (int col = 0; col < cols; col++) {
+				if (InMaskPre.ptr(row)[col] != InMask.ptr(row)[col]) {
+					counts[(row / referenceTile) * tileCols + col / referenceTile]++;
+					changed++;
+				}
+			}
+		}
+	}
+
+	//Intensity scaled by how much more the tiles touching the region move than the whole frame, at most 1.
+	float region(float intensity, int rowBegin, int rowEnd, int colBegin, int colEnd) const {
+		float frame = float(changed) / (float(rows) * float(cols));
+		if (frame <= 0) {
+			return intensity;
+		}
+		uint64_t regionChanged = 0;
+		uint64_t regionPixels = 0;
+		for (int tileRow = std::max(0, rowBegin / referenceTile); tileRow < std::min(tileRows, (rowEnd + referenceTile - 1) / referenceTile); tileRow++) {
+			for (int tileCol = std::max(0, colBegin / referenceTile); tileCol < std::min(tileCols, (colEnd + referenceTile - 1) / referenceTile); tileCol++) {
+				regionChanged += counts[tileRow * tileCols + tileCol];
+				regionPixels += uint64_t(std::min(referenceTile, rows - tileRow * referenceTile)) * std::min(referenceTile, cols - tileCol * referenceTile);
+			}
+		}
+		float fraction = regionPixels ? float(regionChanged) / float(regionPixels) : frame;
+		return std::min(1.0f, intensity * fraction / frame);
+	}
+};
+
+//--------------------------------------------------------------
+Mat splitRGB(const Mat& InMat, float intensity, uint64_t seed, bool shiftRows) {
+	FrameRandom random(seed, shiftRows ? RANDOM_SPLIT_RGB2 : RANDOM_SPLIT_RGB1);
+	int split = 250 * intensity * random.uniform(0);
+	Mat matOut(InMat.rows, InMat.cols, CV_8UC3);
+	for (int row = 0; row < InMat.rows; row++) {
+		int sourceRow = shiftRows ? (row + split) % InMat.rows : row;
+		for (int col = 0; col < InMat.cols; col++) {
+			uchar* out = pixel(matOut, row, col);
+			out[0] = pixel(InMat, sourceRow, wrap(col + split, InMat.cols))[0];
+			out[1] = pixel(InMat, row, col)[1];
+			out[2] = pixel(InMat, sourceRow, wrap(col - split, InMat.cols))[2];
+		}
+	}
+	return matOut;
+}
+
+//scanLine, and timeScanLine when past is not empty: each row also picks its source frame from the history.
+Mat scanLine(const Mat& InMat, float intensity, uint64_t seed, const Motion& motion, const std::vector<const Mat*>& past) {
+	bool temporal = !past.empty();
+	FrameRandom random(seed, temporal ? RANDOM_TIME_SCAN_LINE : RANDOM_SCAN_LINE);
+	Mat matOut(InMat.rows, InMat.cols, CV_8UC3);
+	for (int row = 0; row < InMat.rows; row++) {
+		int tileBegin = row / referenceTile * referenceTile;
+		float band = motion.region(intensity, tileBegin, tileBegin + referenceTile, 0, InMat.cols);
+		const Mat* source = &InMat;
+		int split;
+		if (temporal) {
+			split = 250 * band * (random.uniform(2 * row) * 2 - 1);
+			int age = int((past.size() + 1) * band * random.uniform(2 * row + 1));
+			source = age > 0 ? past[age - 1] : &InMat;
+		}
+		else {
+			split = 250 * band * (random.uniform(row) * 2 - 1);
+		}
+		for (int col = 0; col < InMat.cols; col++) {
+			memcpy(pixel(matOut, row, col), pixel(*source, row, wrap(col + split, InMat.cols)), 3);
+		}
+	}
+	return matOut;
+}
+
+//--------------------------------------------------------------
+Mat sand(const Mat& InMat, float intensity, uint64_t seed) {
+	FrameRandom random(seed, RANDOM_SAND);
+	Mat matOut(InMat.rows, InMat.cols, CV_8UC3);
+	for (int row = 0; row < InMat.rows; row++) {
+		for (int col = 0; col < InMat.cols; col++) {
+			uint64_t counter = uint64_t(row) * InMat.cols + col;
+			int splitX = 250 * intensity * (random.uniform(2 * counter) * 2 - 1);
+			int splitY = 250 * intensity * (random.uniform(2 * counter + 1) * 2 - 1);
+			memcpy(pixel(matOut, row, col), pixel(InMat, wrap(row + splitY, InMat.rows), wrap(col + splitX, InMat.cols)), 3);
+		}
+	}
+	return matOut;
+}
+
+//block1, block2 (threshold) and freezeBlock (threshold, freeze) on a 10 x 10 grid. A frozen block shows the
+//history frame of its age, current is the index of the frame being rendered.
+Mat block(const Mat& InMat, float intensity, uint64_t seed, const Motion& motion, bool threshold, bool freeze,
+	const std::vector<const Mat*>& past, uint64_t current) {
+	const int grid = 10;
+	FrameRandom random(seed, freeze ? RANDOM_FREEZE_BLOCK : threshold ? RANDOM_BLOCK2 : RANDOM_BLOCK1);
+	int blockCols = std::max(1, InMat.cols / grid);
+	int blockRows = std::max(1, InMat.rows / grid);
+	float cellIntensity[grid * grid];
+	uchar noise[grid * grid];
+	const Mat* source[grid * grid];
+	for (int i = 0; i < grid * grid; i++) {
+		int rowBegin = i / grid * blockRows;
+		int rowEnd = i / grid == grid - 1 ? InMat.rows : rowBegin + blockRows;
+		int colBegin = i % grid * blockCols;
+		int colEnd = i % grid == grid - 1 ? InMat.cols : colBegin + blockCols;
+		cellIntensity[i] = motion.region(intensity, rowBegin, rowEnd, colBegin, colEnd);
+		if (threshold) {
+			noise[i] = random.uniform(2 * i) * 255;
+			if (random.uniform(2 * i + 1) > cellIntensity[i]) {
+				noise[i] = 0;
+			}
+		}
+		else {
+			noise[i] = random.uniform(i) * 255;
+		}
+		int frames = int(past.size());
+		int age = freeze && frames > 0 ? int((current + mixRandom(i) % frames) % frames) + 1 : 0;
+		source[i] = noise[i] && age > 0 ? past[age - 1] : &InMat;
+	}
+
+	Mat matOut(InMat.rows, InMat.cols, CV_8UC3);
+	for (int row = 0; row < InMat.rows; row++) {
+		for (int col = 0; col < InMat.cols; col++) {
+			int i = std::min(row / blockRows, grid - 1) * grid + std::min(col / blockCols, grid - 1);
+			float value = noise[i];
+			int split = 5 * cellIntensity[i] * value;
+			uchar* out = pixel(matOut, row, col);
+			out[0] = pixel(*source[i], row, wrap(col + split, InMat.cols))[0];
+			out[1] = pixel(*source[i], row, col)[1];
+			out[2] = pixel(*source[i], row, wrap(col - split, InMat.cols))[2];
+		}
+	}
+	return matOut;
+}
+
+//First frame of digitalStripe (inverse) and intDigitalStripe: a bank of 64 noise rows of random runs, each
+//cluster of rows shows one of them.
+Mat stripe(const Mat& InMat, float intensity, uint64_t seed, bool inverse) {
+	FrameRandom random(seed, inverse ? RANDOM_DIGITAL_STRIPE : RANDOM_INT_DIGITAL_STRIPE);
+	uint64_t counter = 0;
+	int clusterRows = std::max(1, InMat.rows / (inverse ? 25 : 30));
+	int gateLevel = int(intensity * 256);
+	const int bankSize = 64;
+	Mat matBank(bankSize, InMat.cols, CV_8UC4);
+	for (int pattern = 0; pattern < bankSize; pattern++) {
+		for (int col = 0; col < InMat.cols;) {
+			int length = std::min(InMat.cols - col, std::max(1, int(random.uniform(counter++) * InMat.cols * (1 - intensity))));
+			uchar red = random.uniform(counter++) * 255;
+			uchar green = random.uniform(counter++) * 255;
+			uchar blue = random.uniform(counter++) * 255;
+			uchar gate = random.uniform(counter++) * 256;
+			for (int i = 0; i < length; i++, col++) {
+				uchar* bank = pixel(matBank, pattern, col);
+				bank[0] = red;
+				bank[1] = green;
+				bank[2] = blue;
+				bank[3] = gate < gateLevel ? 255 : 0;
+			}
+		}
+	}
+	std::vector<int> clusters(InMat.rows / clusterRows + 1);
+	for (auto& cluster : clusters) {
+		cluster = int(random.bits(counter++) % bankSize);
+	}
+
+	Mat matOut(InMat.rows, InMat.cols, CV_8UC3);
+	for (int row = 0; row < InMat.rows; row++) {
+		for (int col = 0; col < InMat.cols; col++) {
+			const uchar* bank = pixel(matBank, clusters[row / clusterRows], col);
+			const uchar* in = pixel(InMat, row, col);
+			uchar* out = pixel(matOut, row, col);
+			for (int channel = 0; channel < 3; channel++) {
+				if (inverse) {
+					out[channel] = bank[3] ? uchar(255 - (in[channel] * 0.5 + 0.5 * bank[channel])) : in[channel];
+				}
+				else {
+					out[channel] = bank[3] * bank[channel];
+				}
+			}
+		}
+	}
+	return matOut;
+}
+
+}
+
+//Same state as the regression check's cases: the camera frames merged in order, the second merge is the input of
+//the effects and both camera frames stand in for its history, newest first.
+std::vector<std::pair<std::string, Mat>> renderReferenceFrames(const ReferenceInputs& inputs) {
+	const Mat& matImg = inputs.matImg;
+	float intensity = inputs.intensity;
+	uint64_t seed = inputs.seed;
+
+	Mat matMask = mask(inputs.matCam[0], 1);
+	Motion motion(matMask, mask(inputs.matCam[1], 1));
+	Mat matMerge = blend(matImg, inputs.matCam[1], inputs.alphaCam);
+	std::vector<const Mat*> past = { &inputs.matCam[1], &inputs.matCam[0] };
+	std::vector<const Mat*> noPast;
+	uint64_t current = 2;
+
+	std::vector<std::pair<std::string, Mat>> frames;
+	//merge, mask and blend run one more merge, of the first camera frame.
+	frames.emplace_back("merge", blend(matImg, inputs.matCam[0], inputs.alphaCam));
+	frames.emplace_back("mask", matMask);
+	frames.emplace_back("mask_half", mask(inputs.matCam[0], 2));
+	frames.emplace_back("blend", blend(matImg, inputs.matCam[0], inputs.alphaCam));
+	frames.emplace_back("splitRGB1", splitRGB(matMerge, intensity, seed, false));
+	frames.emplace_back("splitRGB2", splitRGB(matMerge, intensity, seed, true));
+	frames.emplace_back("scanLine", scanLine(matMerge, intensity, seed, motion, noPast));
+	frames.emplace_back("sand", sand(matMerge, intensity, seed));
+	frames.emplace_back("block1", block(matMerge, intensity, seed, motion, false, false, past, current));
+	frames.emplace_back("block2", block(matMerge, intensity, seed, motion, true, false, past, current));
+	frames.emplace_back("digitalStripe", stripe(matMerge, intensity, seed, true));
+	frames.emplace_back("intDigitalStripe", stripe(matMerge, intensity, seed, false));
+	frames.emplace_back("timeScanLine", scanLine(matMerge, intensity, seed, motion, past));
+	frames.emplace_back("freezeBlock", block(matMerge, intensity, seed, motion, true, true, past, current));
+
+	//scanLine > block1 > digitalStripe, stages after the first take derived seeds like in EffectChain.
+	Mat matChain = scanLine(matMerge, intensity, seed, motion, noPast);
+	matChain = block(matChain, intensity, deriveFrameSeed(seed, 1), motion, false, false, past, current);
+	frames.emplace_back("chain", stripe(matChain, intensity, deriveFrameSeed(seed, 2), true));
+	return frames;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+//Inputs of the reference frames, the same ones the regression check runs the kernels on.
+struct ReferenceInputs {
+	cv::Mat matImg;
+	//Merged first and second, the motion is where the mask changed in between.
+	cv::Mat matCam[2];
+	float alphaCam = 0;
+	float intensity = 0;
+	uint64_t seed = 0;
+};
+
+//The golden frames of the regression check, rendered with plain per pixel loops in the style of the original kernels
+//instead of the optimized ones they check: single threaded, no stages, no RowRemap, no SIMD. The changes the
+//kernels went through on purpose (seeded draws, per tile motion intensity, the fixed-point blend, the integer
+//gray and Otsu mask, the stripe pattern bank, the history effects) are written out by hand.
+//Keyed by golden frame name, "--check reference" writes them.
+std::vector<std::pair<std::string, cv::Mat>> renderReferenceFrames(const ReferenceInputs& inputs);
@@ -0,0 +1,516 @@
+#include "RegressionCheck.h"
+#include "Benchmark.h"
+#include "Postprocess.h"
+#include "Blend.h"
+#include "EffectChain.h"
+#include "ReferenceFrames.h"
+#include "DataPath.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace cv;
+
+namespace {
+
+//Inputs the golden frames are recorded with, changing any of them needs a new recording.
+const int checkCols = 640;
+const int checkRows = 480;
+const float checkAlphaCam = 0.3f;
+const float checkIntensity = 0.7f;
+const uint64_t checkSeed = 1234;
+
+struct CheckFrame {
+	Mat matImg;
+	Mat matCam[2];
+	Mat matMerge;
+	Mat matResult;
+	Mat matMask;
+	Mat matMaskPre;
+	MotionMap motion;
+	PlanarFrame planarMerge;
+	PlanarFrame planarResult;
+	//The camera frames stand in for earlier merges of the temporal effects.
+	FrameHistory history;
+	EffectChain effectChain;
+	int iteration = 0;
+};
+
+//One output to compare. Cases sharing a golden frame must give the same output: a planar effect and its
+//interleaved version, the blend paths.
+struct CheckCase {
+	std::string name;
+	std::string golden;
+	std::function<const Mat&(CheckFrame&)> run;
+};
+
+//--------------------------------------------------------------
+std::vector<CheckCase> getCheckCases() {
+	std::vector<CheckCase> cases;
+	cases.push_back({ "merge", "merge", [](CheckFrame& frame) -> const Mat& {
+		mergeFrame(frame.matMerge, frame.matMask, frame.motion, frame.matMaskPre, frame.matImg, frame.matCam[frame.iteration & 1], checkAlphaCam);
+		return frame.matMerge;
+	} });
+	cases.push_back({ "merge_mask", "mask", [](CheckFrame& frame) -> const Mat& {
+		mergeFrame(frame.matMerge, frame.matMask, frame.motion, frame.matMaskPre, frame.matImg, frame.matCam[frame.iteration & 1], checkAlphaCam);
+		return frame.matMask;
+	} });
+	cases.push_back({ "mask_half", "mask_half", [](CheckFrame& frame) -> const Mat& {
+		analyzeMask(frame.matMask, frame.motion, frame.matMaskPre, frame.matCam[frame.iteration & 1], 2);
+		return frame.matMask;
+	} });
+	//Every fixed-point path this CPU runs must blend to the same bytes.
+	for (BlendPath path : { BLEND_SCALAR, BLEND_SSE2, BLEND_AVX2 }) {
+		BlendRowFunc blendRow = getBlendRow(path);
+		if (!blendRow) {
+			continue;
+		}
+		cases.push_back({ std::string("blend_") + getBlendPathName(path), "blend", [blendRow](CheckFrame& frame) -> const Mat& {
+			const Mat& cam = frame.matCam[frame.iteration & 1];
+			int weight = blendWeight(checkAlphaCam);
+			getPostprocessPool().parallelFor(0, frame.matImg.rows, 0, [&](int rowBegin, int rowEnd) {
+				for (int row = rowBegin; row < rowEnd; row++) {
+					blendRow(frame.matMerge.ptr(row), frame.matImg.ptr(row), cam.ptr(row), frame.matImg.cols * 3, weight);
+				}
+			});
+			return frame.matMerge;
+		} });
+	}
+	cases.push_back({ "blend_planar", "blend", [](CheckFrame& frame) -> const Mat& {
+		blendFramePlanar(frame.planarMerge, frame.matImg, frame.matCam[frame.iteration & 1], checkAlphaCam);
+		mergePlanes(frame.matResult, frame.planarMerge);
+		return frame.matResult;
+	} });
+	for (auto& entry : getPostprocessList()) {
+		PostprocessFunc func = entry.func;
+		cases.push_back({ entry.name, entry.name, [func](CheckFrame& frame) -> const Mat& {
+			setFrameSeed(checkSeed);
+			func(frame.matResult, frame.matMerge, checkIntensity);
+			return frame.matResult;
+		} });
+	}
+	for (auto& entry : getPostprocessList()) {
+		if (!entry.planar) {
+			continue;
+		}
+		PlanarPostprocessFunc planar = entry.planar;
+		cases.push_back({ std::string(entry.name) + "_planar", entry.name, [planar](CheckFrame& frame) -> const Mat& {
+			setFrameSeed(checkSeed);
+			planar(frame.planarResult, frame.planarMerge, checkIntensity);
+			mergePlanes(frame.matResult, frame.planarResult);
+			return frame.matResult;
+		} });
+	}
+	//Fused row local stages.
+	cases.push_back({ "chain", "chain", [](CheckFrame& frame) -> const Mat& {
+		if (frame.effectChain.empty()) {
+			frame.effectChain.append("scanLine");
+			frame.effectChain.append("block1");
+			frame.effectChain.append("digitalStripe");
+		}
+		setFrameSeed(checkSeed);
+		frame.effectChain.process(frame.matResult, frame.matMerge, checkIntensity);
+		return frame.matResult;
+	} });
+	return cases;
+}
+
+//Same state before every case: the second of two merges, so that the mask and the motion map see the box move.
+void resetFrame(CheckFrame& frame) {
+	frame.iteration = 0;
+	frame.effectChain.clear();
+	frame.matMaskPre.release();
+	mergeFrame(frame.matMerge, frame.matMask, frame.motion, frame.matMaskPre, frame.matImg, frame.matCam[0], checkAlphaCam);
+	mergeFrame(frame.matMerge, frame.matMask, frame.motion, frame.matMaskPre, frame.matImg, frame.matCam[1], checkAlphaCam);
+	splitPlanes(frame.planarMerge, frame.matMerge);
+	setMotionMap(&frame.motion);
+	frame.history.setCapacity(2);
+	for (int i = 0; i < 2; i++) {
+		FrameHistory::Entry entry;
+		entry.merge = &frame.matCam[i];
+		entry.index = i;
+		frame.history.push(entry);
+	}
+	setFrameHistory(&frame.history);
+	setPixelScale(1);
+	setFrameSeed(checkSeed);
+}
+
+//--------------------------------------------------------------
+std::string getGoldenPath(const RegressionSettings& settings, const std::string& name) {
+	return settings.directory + "/" + name + ".png";
+}
+
+//Creates the directory and its missing parents, true if it exists afterwards.
+bool createDirectories(const std::string& path) {
+	for (size_t end = 1; end <= path.size(); end++) {
+		if (end < path.size() && path[end] != '/' && path[end] != '\\') {
+			continue;
+		}
+		std::string parent = path.substr(0, end);
+#ifdef _WIN32
+		_mkdir(parent.c_str());
+#else
+		mkdir(parent.c_str(), 0755);
+#endif
+	}
+#ifdef _WIN32
+	struct _stat info;
+	return _stat(path.c_str(), &info) == 0 && (info.st_mode & _S_IFDIR);
+#else
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+//PNG is lossless, color frames are stored as BGR like any other image.
+bool writeGolden(const std::string& path, const Mat& mat) {
+	if (mat.channels() == 3) {
+		Mat bgr;
+		cvtColor(mat, bgr, COLOR_RGB2BGR);
+		return imwrite(path, bgr);
+	}
+	return imwrite(path, mat);
+}
+
+//--------------------------------------------------------------
+Mat readGolden(const std::string& path) {
+	Mat mat = imread(path, IMREAD_UNCHANGED);
+	if (mat.channels() == 3) {
+		cvtColor(mat, mat, COLOR_BGR2RGB);
+	}
+	return mat;
+}
+
+//Number of pixels with a channel more than maxDiff away from the golden frame, -1 for another size or type.
+int64_t countDifferent(const Mat& InActual, const Mat& InGolden, int maxDiff, int& OutLargest) {
+	OutLargest = 0;
+	if (InActual.rows != InGolden.rows || InActual.cols != InGolden.cols || InActual.type() != InGolden.type()) {
+		return -1;
+	}
+	int channels = InActual.channels();
+	int64_t different = 0;
+	for (int row = 0; row < InActual.rows; row++) {
+		const uchar* actual = InActual.ptr(row);
+		const uchar* golden = InGolden.ptr(row);
+		for (int col = 0; col < InActual.cols; col++) {
+			bool pixelDifferent = false;
+			for (int channel = 0; channel < channels; channel++, actual++, golden++) {
+				int difference = std::abs(int(*actual) - int(*golden));
+				OutLargest = std::max(OutLargest, difference);
+				pixelDifferent |= difference > maxDiff;
+			}
+			different += pixelDifferent;
+		}
+	}
+	return different;
+}
+
+//Median time of each case at one pool size.
+struct Baseline {
+	unsigned threads = 0;
+	std::map<std::string, double> medianMs;
+};
+
+//--------------------------------------------------------------
+bool readBaseline(const std::string& path, Baseline& baseline) {
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+	std::string line;
+	std::getline(file, line);
+	while (std::getline(file, line)) {
+		std::vector<std::string> fields;
+		std::stringstream stream(line);
+		std::string field;
+		while (std::getline(stream, field, ',')) {
+			fields.push_back(field);
+		}
+		if (fields.size() != 5 || std::stoi(fields[1]) != checkCols || std::stoi(fields[2]) != checkRows) {
+			continue;
+		}
+		baseline.threads = unsigned(std::stoul(fields[3]));
+		baseline.medianMs[fields[0]] = std::stod(fields[4]);
+	}
+	return !baseline.medianMs.empty();
+}
+
+//--------------------------------------------------------------
+void printUsage() {
+	std::cerr << "usage: InteractiveGlitchArtPostprocessing --check record|baseline|verify|reference [options]\n"
+		<< "  --dir path          golden frames and baseline (default golden/ in the data folder)\n"
+		<< "  --max-diff n        allowed difference of a channel value (default 0, bit exact)\n"
+		<< "  --tolerance pct     allowed slowdown over the baseline (default 10)\n"
+		<< "  --no-timing         compare outputs only\n"
+		<< "  --threads n,...     pool sizes to check outputs at, timing uses the last (default 1 and all cores)\n"
+		<< "  --warmup n          untimed iterations per case (default 3)\n"
+		<< "  --iterations n      timed iterations per case (default 20)\n";
+}
+
+}
+
+//--------------------------------------------------------------
+bool parseRegressionArgs(int argc, char* argv[], RegressionSettings& settings) {
+	bool hasMode = false;
+	//Option whose value is being parsed, named when std::sto* rejects the value.
+	std::string option;
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			option = arg;
+			bool hasValue = i + 1 < argc;
+			if (arg == "--check" && hasValue) {
+				std::string mode = argv[++i];
+				if (mode != "record" && mode != "baseline" && mode != "verify" && mode != "reference") {
+					std::cerr << "unknown mode " << mode << "\n";
+					printUsage();
+					return false;
+				}
+				settings.record = mode == "record";
+				settings.recordBaseline = mode == "record" || mode == "baseline";
+				settings.reference = mode == "reference";
+				hasMode = true;
+			}
+			else if (arg == "--dir" && hasValue) {
+				settings.directory = argv[++i];
+			}
+			else if (arg == "--max-diff" && hasValue) {
+				settings.maxDiff = std::max(0, std::stoi(argv[++i]));
+			}
+			else if (arg == "--tolerance" && hasValue) {
+				settings.tolerancePercent = std::stod(argv[++i]);
+			}
+			else if (arg == "--no-timing") {
+				settings.timing = false;
+			}
+			else if (arg == "--threads" && hasValue) {
+				std::stringstream stream(argv[++i]);
+				std::string item;
+				settings.threads.clear();
+				while (std::getline(stream, item, ',')) {
+					if (!item.empty()) {
+						settings.threads.push_back(std::max(1u, unsigned(std::stoul(item))));
+					}
+				}
+			}
+			else if (arg == "--warmup" && hasValue) {
+				settings.warmup = std::max(0, std::stoi(argv[++i]));
+			}
+			else if (arg == "--iterations" && hasValue) {
+				settings.iterations = std::max(1, std::stoi(argv[++i]));
+			}
+			else {
+				std::cerr << "unknown option " << arg << "\n";
+				printUsage();
+				return false;
+			}
+		}
+	}
+	catch (const std::logic_error&) {
+		std::cerr << "invalid value for " << option << "\n";
+		printUsage();
+		return false;
+	}
+	if (!hasMode) {
+		printUsage();
+		return false;
+	}
+	if (settings.directory.empty()) {
+		settings.directory = getDataPath("golden");
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+int runRegressionCheck(const RegressionSettings& settings) {
+
+	std::vector<unsigned> threadCounts = settings.threads;
+	if (threadCounts.empty()) {
+		threadCounts.push_back(1);
+		unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+		if (hardware > 1) {
+			threadCounts.push_back(hardware);
+		}
+	}
+	if ((settings.recordBaseline || settings.reference) && !createDirectories(settings.directory)) {
+		std::cerr << "cannot create " << settings.directory << "\n";
+		return 1;
+	}
+
+	CheckFrame frame;
+	frame.matImg.create(checkRows, checkCols, CV_8UC3);
+	frame.matCam[0].create(checkRows, checkCols, CV_8UC3);
+	frame.matCam[1].create(checkRows, checkCols, CV_8UC3);
+	frame.matMerge.create(checkRows, checkCols, CV_8UC3);
+	frame.matResult.create(checkRows, checkCols, CV_8UC3);
+	fillSynthetic(frame.matImg, 1, -1);
+	fillSynthetic(frame.matCam[0], 2, checkCols / 4);
+	fillSynthetic(frame.matCam[1], 3, checkCols / 2);
+
+	if (settings.reference) {
+		ReferenceInputs inputs;
+		inputs.matImg = frame.matImg;
+		inputs.matCam[0] = frame.matCam[0];
+		inputs.matCam[1] = frame.matCam[1];
+		inputs.alphaCam = checkAlphaCam;
+		inputs.intensity = checkIntensity;
+		inputs.seed = checkSeed;
+		for (auto& entry : renderReferenceFrames(inputs)) {
+			std::string path = getGoldenPath(settings, entry.first);
+			if (!writeGolden(path, entry.second)) {
+				std::cerr << "cannot write " << path << "\n";
+				return 1;
+			}
+			std::cout << "reference " << entry.first << " -> " << path << "\n";
+		}
+		return 0;
+	}
+
+	std::vector<CheckCase> cases = getCheckCases();
+	int failures = 0;
+
+	//Outputs. When recording, the first case of a golden frame writes it and the others must match it.
+	std::map<std::string, Mat> goldens;
+	for (unsigned threads : threadCounts) {
+		ThreadPool threadPool(threads);
+		setPostprocessPool(&threadPool);
+		for (auto& entry : cases) {
+			//Effects keep state per thread from frame to frame (the stripe pattern bank), each golden run is the
+			//first frame of a new thread.
+			Mat actual;
+			std::thread([&]() {
+				resetFrame(frame);
+				actual = entry.run(frame);
+			}).join();
+			std::string path = getGoldenPath(settings, entry.golden);
+
+			auto golden = goldens.find(entry.golden);
+			if (golden == goldens.end()) {
+				if (settings.record) {
+					if (!writeGolden(path, actual)) {
+						std::cerr << "cannot write " << path << "\n";
+						setPostprocessPool(nullptr);
+						return 1;
+					}
+					goldens[entry.golden] = actual.clone();
+					std::cout << "recorded " << entry.name << " -> " << path << "\n";
+					continue;
+				}
+				golden = goldens.emplace(entry.golden, readGolden(path)).first;
+			}
+			if (golden->second.empty()) {
+				std::cout << "MISSING  " << entry.name << ": no golden frame " << path << "\n";
+				failures++;
+				continue;
+			}
+
+			int largest;
+			int64_t different = countDifferent(actual, golden->second, settings.maxDiff, largest);
+			if (different == 0) {
+				std::cout << "ok       " << entry.name << " (threads " << threads << ", max difference " << largest << ")\n";
+				continue;
+			}
+			failures++;
+			std::string actualPath = settings.directory + "/" + entry.name + "_t" + std::to_string(threads) + "_actual.png";
+			writeGolden(actualPath, actual);
+			if (different < 0) {
+				std::cout << "CHANGED  " << entry.name << " (threads " << threads << "): " << actual.cols << "x" << actual.rows
+					<< " with " << actual.channels() << " channels against " << golden->second.cols << "x" << golden->second.rows
+					<< " with " << golden->second.channels() << ", output in " << actualPath << "\n";
+			}
+			else {
+				std::cout << "CHANGED  " << entry.name << " (threads " << threads << "): " << different << " pixels, max difference "
+					<< largest << ", output in " << actualPath << "\n";
+			}
+		}
+		setPostprocessPool(nullptr);
+	}
+
+	//Throughput at the last pool size. Timings only compare on the machine and pool size they were recorded with.
+	if (settings.timing) {
+		unsigned threads = threadCounts.back();
+		std::string baselinePath = settings.directory + "/baseline.csv";
+		Baseline baseline;
+		bool compare = false;
+		if (!settings.recordBaseline) {
+			if (!readBaseline(baselinePath, baseline)) {
+				std::cout << "MISSING  no baseline " << baselinePath << "\n";
+				failures++;
+			}
+			else if (baseline.threads != threads) {
+				std::cout << "baseline recorded with " << baseline.threads << " threads, timings not compared\n";
+			}
+			else {
+				compare = true;
+			}
+		}
+
+		std::ofstream file;
+		if (settings.recordBaseline) {
+			file.open(baselinePath);
+			if (!file) {
+				std::cerr << "cannot write " << baselinePath << "\n";
+				return 1;
+			}
+			file << "case,width,height,threads,median_ms\n";
+		}
+
+		ThreadPool threadPool(threads);
+		setPostprocessPool(&threadPool);
+		for (auto& entry : cases) {
+			resetFrame(frame);
+			std::vector<double> samples;
+			for (int i = 0; i < settings.warmup + settings.iterations; i++) {
+				frame.iteration = i;
+				auto start = std::chrono::steady_clock::now();
+				entry.run(frame);
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				if (i >= settings.warmup) {
+					samples.push_back(seconds);
+				}
+			}
+			std::sort(samples.begin(), samples.end());
+			double medianMs = samples[samples.size() / 2] * 1e3;
+
+			if (settings.recordBaseline) {
+				file << entry.name << "," << checkCols << "," << checkRows << "," << threads << "," << medianMs << "\n";
+				std::cout << "timed    " << entry.name << ": " << medianMs << " ms\n";
+				continue;
+			}
+			auto recorded = baseline.medianMs.find(entry.name);
+			if (!compare || recorded == baseline.medianMs.end() || recorded->second <= 0) {
+				std::cout << "timed    " << entry.name << ": " << medianMs << " ms\n";
+				continue;
+			}
+			double change = (medianMs / recorded->second - 1) * 100;
+			bool slower = change > settings.tolerancePercent;
+			failures += slower;
+			std::cout << (slower ? "SLOWER   " : "ok       ") << entry.name << ": " << medianMs << " ms, baseline "
+				<< recorded->second << " ms (" << (change >= 0 ? "+" : "") << change << "%)\n";
+		}
+		setPostprocessPool(nullptr);
+	}
+	setMotionMap(nullptr);
+	setFrameHistory(nullptr);
+
+	if (failures > 0) {
+		std::cout << failures << " regressions\n";
+		return 1;
+	}
+	std::cout << (settings.record ? "recorded in " : "no regressions against ") << settings.directory << "\n";
+	return 0;
+}
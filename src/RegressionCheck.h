@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//Golden frame and throughput regression check, headless: no window, camera or GL. Every effect, its planar version,
+//every blend path, the merge and the mask run on fixed synthetic frames with a fixed seed and intensity.
+//"record" stores each output as a PNG and the median time of each case in baseline.csv, "verify" compares against
+//them and fails when an output changed or a case got slower than the baseline by more than the tolerance.
+//"baseline" verifies the outputs and records the timings only: the golden frames are committed, the baseline is
+//machine specific and stays local. "reference" writes the golden frames from plain reference loops instead of the
+//kernels, see ReferenceFrames.h, that is how the committed ones were recorded.
+//Outputs are checked at several pool sizes, they must not depend on it.
+struct RegressionSettings {
+	bool record = false;
+	bool recordBaseline = false;
+	bool reference = false;
+	//Golden frames and baseline. Empty is golden/ in the data folder, see getDataPath.
+	std::string directory;
+	//Largest allowed difference of a channel value, 0 for bit exact.
+	int maxDiff = 0;
+	//Slowdown over the baseline that fails, in percent.
+	double tolerancePercent = 10;
+	bool timing = true;
+	//Pool sizes the outputs are checked at, timing uses the last one. Empty means 1 and hardware_concurrency.
+	std::vector<unsigned> threads;
+	int warmup = 3;
+	int iterations = 20;
+};
+
+//Parses "--check record|baseline|verify|reference" style arguments, returns false and prints usage on error.
+bool parseRegressionArgs(int argc, char* argv[], RegressionSettings& settings);
+
+//Returns a process exit code, 1 on any regression.
+int runRegressionCheck(const RegressionSettings& settings);
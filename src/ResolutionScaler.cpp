@@ -0,0 +1,66 @@
+#include "ResolutionScaler.h"
+
+#include <algorithm>
+
+//Fraction of the full size on each side.
+static const float levelScales[ResolutionScaler::levelCount] = { 1.0f, 0.85f, 0.7f, 0.6f, 0.5f, 0.4f, 0.33f, 0.25f };
+
+//--------------------------------------------------------------
+float ResolutionScaler::getLevelScale(int level) {
+	return levelScales[std::max(0, std::min(levelCount - 1, level))];
+}
+
+//--------------------------------------------------------------
+void ResolutionScaler::setEnabled(bool enabled) {
+	this->enabled = enabled;
+	if (!enabled) {
+		setLevel(0);
+	}
+}
+
+//--------------------------------------------------------------
+bool ResolutionScaler::addFrame(double ms) {
+	if (!enabled) {
+		return false;
+	}
+	if (settle > 0) {
+		settle--;
+		averageMs = ms;
+		return false;
+	}
+	averageMs = averageMs * 0.9 + ms * 0.1;
+
+	//Pixel count ratio between two levels.
+	auto predict = [this](int to) {
+		float ratio = getLevelScale(to) / getLevelScale(level);
+		return averageMs * ratio * ratio;
+	};
+
+	overCount = averageMs > budgetMs ? overCount + 1 : 0;
+	underCount = level > 0 && predict(level - 1) < budgetMs * 0.8 ? underCount + 1 : 0;
+
+	if (overCount >= downFrames && level < levelCount - 1) {
+		//Straight to the first level expected to fit with a little room.
+		int target = level + 1;
+		while (target < levelCount - 1 && predict(target) > budgetMs * 0.9) {
+			target++;
+		}
+		setLevel(std::min(target, levelCount - 1));
+		return true;
+	}
+	if (underCount >= upFrames) {
+		setLevel(level - 1);
+		return true;
+	}
+	return false;
+}
+
+//--------------------------------------------------------------
+void ResolutionScaler::setLevel(int level) {
+	if (level != this->level) {
+		this->level = level;
+		settle = settleFrames;
+	}
+	overCount = 0;
+	underCount = 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+//Picks the processing resolution that keeps the frame time under a budget.
+//Scales come from a fixed ladder so buffers of a few sizes get reused. Going down is quick when the budget is
+//blown, going up waits until the next finer step is predicted (time grows with the pixel count) to fit with
+//headroom for a while, so that the scale does not oscillate around the budget.
+class ResolutionScaler {
+
+	public:
+		static const int levelCount = 8;
+
+		void setEnabled(bool enabled);
+		bool isEnabled() const { return enabled; }
+
+		void setBudgetMs(double ms) { budgetMs = ms; }
+		double getBudgetMs() const { return budgetMs; }
+
+		//Processing time of one frame at the current scale. Returns true when the scale changed.
+		bool addFrame(double ms);
+
+		int getLevel() const { return level; }
+		float getScale() const { return getLevelScale(level); }
+		static float getLevelScale(int level);
+
+	private:
+		//Frames to ignore after a change, while the frames already in flight at the old scale finish.
+		static const int settleFrames = 10;
+		//Consecutive frames over the budget before stepping down.
+		static const int downFrames = 8;
+		//Consecutive frames with room for the next finer step before stepping up.
+		static const int upFrames = 60;
+
+		void setLevel(int level);
+
+		bool enabled = false;
+		double budgetMs = 16.6;
+		int level = 0;
+		//Exponential moving average of the frame time.
+		double averageMs = 0;
+		int settle = 0;
+		int overCount = 0;
+		int underCount = 0;
+};
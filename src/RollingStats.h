@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+//Mean and percentiles over the last `window` samples, for per frame timings.
+class RollingStats {
+
+	public:
+		explicit RollingStats(size_t window = 120) : window(window) {
+			samples.reserve(window);
+		}
+
+		void add(double value) {
+			if (samples.size() < window) {
+				samples.push_back(value);
+			}
+			else {
+				samples[next] = value;
+			}
+			next = (next + 1) % window;
+		}
+
+		void clear() {
+			samples.clear();
+			next = 0;
+		}
+
+		size_t count() const { return samples.size(); }
+
+		double mean() const {
+			double sum = 0;
+			for (double sample : samples) {
+				sum += sample;
+			}
+			return samples.empty() ? 0 : sum / samples.size();
+		}
+
+		//p in [0, 1].
+		double percentile(double p) const {
+			if (samples.empty()) {
+				return 0;
+			}
+			std::vector<double> sorted(samples);
+			size_t index = std::min(sorted.size() - 1, size_t(p * sorted.size()));
+			std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+			return sorted[index];
+		}
+
+	private:
+		size_t window;
+		size_t next = 0;
+		std::vector<double> samples;
+};
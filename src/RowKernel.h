@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+//Threading of the effect passes. Effects only say what one row or one pixel does, as a functor the compiler inlines
+//into the band loop and specializes per effect. The pool cuts [0, rows) into bands exactly, the last band takes the
+//remainder, so every row and pixel is written once whatever the thread count.
+
+//rowFunc(row) for every row in [0, rows).
+template<class RowFunc>
+void forEachRow(ThreadPool& pool, int rows, const RowFunc& rowFunc) {
+	pool.parallelFor(0, rows, 0, [&](int rowBegin, int rowEnd) {
+		for (int row = rowBegin; row < rowEnd; row++) {
+			rowFunc(row);
+		}
+	});
+}
+
+//pixelFunc(row, col) for every pixel of a rows x cols frame, row after row.
+template<class PixelFunc>
+void forEachPixel(ThreadPool& pool, int rows, int cols, const PixelFunc& pixelFunc) {
+	pool.parallelFor(0, rows, 0, [&](int rowBegin, int rowEnd) {
+		for (int row = rowBegin; row < rowEnd; row++) {
+			for (int col = 0; col < cols; col++) {
+				pixelFunc(row, col);
+			}
+		}
+	});
+}
@@ -0,0 +1,76 @@
+#include "RowRemap.h"
+
+#include <algorithm>
+#include <cstring>
+
+//--------------------------------------------------------------
+int splitCyclicShift(int dstBegin, int dstEnd, int shift, int cols, RowSegment segments[2]) {
+	if (dstEnd <= dstBegin) {
+		return 0;
+	}
+	shift %= cols;
+	if (shift < 0) {
+		shift += cols;
+	}
+	int srcX = dstBegin + shift;
+	if (srcX >= cols) {
+		srcX -= cols;
+	}
+	//First run goes until the source wraps around, the rest starts again from column 0.
+	int first = std::min(dstEnd - dstBegin, cols - srcX);
+	segments[0] = { dstBegin, srcX, first };
+	if (first == dstEnd - dstBegin) {
+		return 1;
+	}
+	segments[1] = { dstBegin + first, 0, dstEnd - dstBegin - first };
+	return 2;
+}
+
+//--------------------------------------------------------------
+static void copyPixels(uint8_t* dst, const uint8_t* src, const RowSegment& segment) {
+	memcpy(dst + segment.dstX * 3, src + segment.srcX * 3, size_t(segment.count) * 3);
+}
+
+//--------------------------------------------------------------
+static void gatherChannel(uint8_t* dst, const uint8_t* src, const RowSegment& segment, int channel) {
+	uint8_t* out = dst + segment.dstX * 3 + channel;
+	const uint8_t* in = src + segment.srcX * 3 + channel;
+	for (int i = 0; i < segment.count; i++) {
+		out[i * 3] = in[i * 3];
+	}
+}
+
+//--------------------------------------------------------------
+void shiftRow(uint8_t* dst, const uint8_t* src, int cols, int dstBegin, int dstEnd, int shift) {
+	RowSegment segments[2];
+	int count = splitCyclicShift(dstBegin, dstEnd, shift, cols, segments);
+	for (int i = 0; i < count; i++) {
+		copyPixels(dst, src, segments[i]);
+	}
+}
+
+//--------------------------------------------------------------
+void rotateRow(uint8_t* dst, const uint8_t* src, int cols, int dstBegin, int dstEnd, int shift) {
+	RowSegment segments[2];
+	int count = splitCyclicShift(dstBegin, dstEnd, shift, cols, segments);
+	for (int i = 0; i < count; i++) {
+		memcpy(dst + segments[i].dstX, src + segments[i].srcX, size_t(segments[i].count));
+	}
+}
+
+//--------------------------------------------------------------
+void remapRow(uint8_t* dst, const uint8_t* const src[3], const int shifts[3], int cols, int dstBegin, int dstEnd) {
+	RowSegment segments[2];
+
+	shiftRow(dst, src[1], cols, dstBegin, dstEnd, shifts[1]);
+
+	for (int channel = 0; channel < 3; channel += 2) {
+		if (src[channel] == src[1] && (shifts[channel] - shifts[1]) % cols == 0) {
+			continue;
+		}
+		int count = splitCyclicShift(dstBegin, dstEnd, shifts[channel], cols, segments);
+		for (int i = 0; i < count; i++) {
+			gatherChannel(dst, src[channel], segments[i], channel);
+		}
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+//Row remap engine for the shift based effects. Every output row of splitRGB, scanLine and block is,
+//per channel, one source row read with a cyclic horizontal shift. A cyclic shift of a run of columns is
+//at most two contiguous source segments, so rows are built with bulk copies and plain strided loops
+//instead of a divide and a modulo per channel per pixel. Rows are interleaved 3 channel bytes.
+
+//count pixels written from dstX on, read from srcX on.
+struct RowSegment {
+	int dstX;
+	int srcX;
+	int count;
+};
+
+//Splits columns [dstBegin, dstEnd) shifted by shift into at most two segments, returns how many.
+int splitCyclicShift(int dstBegin, int dstEnd, int shift, int cols, RowSegment segments[2]);
+
+//dst[x] = src[(x + shift) mod cols] for every channel, x in [dstBegin, dstEnd).
+void shiftRow(uint8_t* dst, const uint8_t* src, int cols, int dstBegin, int dstEnd, int shift);
+
+//Single channel rows of a PlanarFrame: dst[x] = src[(x + shift) mod cols], at most two memcpy.
+void rotateRow(uint8_t* dst, const uint8_t* src, int cols, int dstBegin, int dstEnd, int shift);
+
+//Same per channel: channel c of dst[x] comes from src[c][(x + shifts[c]) mod cols].
+//All channels are first copied as whole pixels with the mapping of the green channel,
+//then red and blue are gathered again where their mapping differs.
+void remapRow(uint8_t* dst, const uint8_t* const src[3], const int shifts[3], int cols, int dstBegin, int dstEnd);
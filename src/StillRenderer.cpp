@@ -0,0 +1,313 @@
+#include "StillRenderer.h"
+#include "Postprocess.h"
+#include "Blend.h"
+#include "EffectChain.h"
+#include "GlitchRandom.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+using namespace cv;
+
+namespace {
+
+//--------------------------------------------------------------
+bool endsWith(const std::string& text, const std::string& suffix) {
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+//Rows of a still image in RGB: a memory mapped binary PPM, or any other image decoded whole.
+class StillSource {
+
+	public:
+		bool open(const std::string& path) {
+			if (endsWith(path, ".ppm")) {
+				return openPPM(path);
+			}
+			Mat bgr = imread(path, IMREAD_COLOR);
+			if (bgr.empty()) {
+				return false;
+			}
+			cvtColor(bgr, decoded, COLOR_BGR2RGB);
+			rows = decoded.rows;
+			cols = decoded.cols;
+			return true;
+		}
+
+		bool isMapped() const { return file.isOpen(); }
+		int getRows() const { return rows; }
+		int getCols() const { return cols; }
+
+		//Rows [rowBegin, rowEnd), one after the other. Valid until the next call, nullptr on a read error.
+		const uchar* mapRows(int rowBegin, int rowEnd) {
+			if (!isMapped()) {
+				return decoded.ptr(rowBegin);
+			}
+			size_t rowBytes = size_t(cols) * 3;
+			return file.map(dataOffset + uint64_t(rowBegin) * rowBytes, size_t(rowEnd - rowBegin) * rowBytes);
+		}
+
+	private:
+		//"P6 <cols> <rows> 255" then a single whitespace and the pixels, # starts a comment in the header.
+		bool openPPM(const std::string& path) {
+			std::ifstream stream(path, std::ios::binary);
+			std::string tokens[4];
+			for (auto& token : tokens) {
+				int c;
+				while ((c = stream.get()) != EOF) {
+					if (c == '#') {
+						while ((c = stream.get()) != EOF && c != '\n') {
+						}
+					}
+					else if (!isspace(c)) {
+						token += char(c);
+					}
+					else if (!token.empty()) {
+						break;
+					}
+				}
+			}
+			if (!stream || tokens[0] != "P6" || tokens[3] != "255") {
+				return false;
+			}
+			cols = std::atoi(tokens[1].c_str());
+			rows = std::atoi(tokens[2].c_str());
+			dataOffset = uint64_t(stream.tellg());
+			return cols > 0 && rows > 0 && file.open(path) && file.getSize() >= dataOffset + uint64_t(rows) * cols * 3;
+		}
+
+		MappedFile file;
+		uint64_t dataOffset = 0;
+		Mat decoded;
+		int rows = 0;
+		int cols = 0;
+};
+
+//OutWindow = rows [windowBegin, windowBegin + OutWindow.rows) of the input, blended with the overlay if any and
+//wrapped around at the edges. At most chunkRows rows of each input are mapped at a time.
+bool fillWindow(Mat& OutWindow, int windowBegin, StillSource& input, StillSource* overlay, float alphaCam, int chunkRows) {
+	int rows = input.getRows();
+	size_t rowBytes = size_t(OutWindow.cols) * 3;
+	BlendRowFunc blendRow = getBestBlendRow();
+	int weight = blendWeight(alphaCam);
+	for (int row = 0; row < OutWindow.rows;) {
+		int frameRow = ((windowBegin + row) % rows + rows) % rows;
+		int count = std::min(std::min(OutWindow.rows - row, rows - frameRow), chunkRows);
+		const uchar* in = input.mapRows(frameRow, frameRow + count);
+		const uchar* over = overlay ? overlay->mapRows(frameRow, frameRow + count) : nullptr;
+		if (!in || (overlay && !over)) {
+			return false;
+		}
+		getPostprocessPool().parallelFor(0, count, 0, [&](int rowBegin, int rowEnd) {
+			for (int i = rowBegin; i < rowEnd; i++) {
+				if (over) {
+					blendRow(OutWindow.ptr(row + i), in + i * rowBytes, over + i * rowBytes, int(rowBytes), weight);
+				}
+				else {
+					memcpy(OutWindow.ptr(row + i), in + i * rowBytes, rowBytes);
+				}
+			}
+		});
+		row += count;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+void printUsage() {
+	std::string effects;
+	for (auto& entry : getPostprocessList()) {
+		effects += std::string(effects.empty() ? "" : ", ") + entry.name;
+	}
+	std::cerr << "usage: InteractiveGlitchArtPostprocessing --still <input> <output.ppm> [options]\n"
+		<< "  input             image, a binary PPM (P6) is read in strips, anything else is decoded whole\n"
+		<< "  output            binary PPM, written strip by strip\n"
+		<< "  --effect name,... " << effects << " (default splitRGB1)\n"
+		<< "                    several names are applied in order\n"
+		<< "  --overlay file    image of the same size blended over the input\n"
+		<< "  --alpha value     overlay alpha in [0, 1] (default 0.3)\n"
+		<< "  --intensity value effect intensity in [0, 1] (default 1)\n"
+		<< "  --pixel-scale f   effect offsets times f (default 1)\n"
+		<< "  --memory MB       strip buffers and mapped rows (default 256)\n"
+		<< "  --threads n       processing threads (default all cores)\n"
+		<< "  --seed n          random seed, printed when not given\n";
+}
+
+}
+
+//--------------------------------------------------------------
+bool parseStillRenderArgs(int argc, char* argv[], StillRenderSettings& settings) {
+	std::vector<std::string> positional;
+	//Option whose value is being parsed, named when std::sto* rejects the value.
+	std::string option;
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			option = arg;
+			bool hasValue = i + 1 < argc;
+			if (arg == "--still") {
+				continue;
+			}
+			else if (arg == "--effect" && hasValue) {
+				settings.effect = argv[++i];
+			}
+			else if (arg == "--overlay" && hasValue) {
+				settings.overlay = argv[++i];
+			}
+			else if (arg == "--alpha" && hasValue) {
+				settings.alphaCam = std::min(1.0f, std::max(0.0f, std::stof(argv[++i])));
+			}
+			else if (arg == "--intensity" && hasValue) {
+				settings.intensity = std::min(1.0f, std::max(0.0f, std::stof(argv[++i])));
+			}
+			else if (arg == "--pixel-scale" && hasValue) {
+				settings.pixelScale = std::max(0.0f, std::stof(argv[++i]));
+			}
+			else if (arg == "--memory" && hasValue) {
+				settings.memoryMB = std::max(1ul, std::stoul(argv[++i]));
+			}
+			else if (arg == "--threads" && hasValue) {
+				settings.threads = std::stoul(argv[++i]);
+			}
+			else if (arg == "--seed" && hasValue) {
+				if (!parseSeed(argv[++i], settings.seed)) {
+					std::cerr << "invalid seed " << argv[i] << "\n";
+					printUsage();
+					return false;
+				}
+				settings.hasSeed = true;
+			}
+			else if (arg.compare(0, 2, "--") == 0) {
+				std::cerr << "unknown option " << arg << "\n";
+				printUsage();
+				return false;
+			}
+			else {
+				positional.push_back(arg);
+			}
+		}
+	}
+	catch (const std::logic_error&) {
+		std::cerr << "invalid value for " << option << "\n";
+		printUsage();
+		return false;
+	}
+	if (positional.size() != 2 || !endsWith(positional[1], ".ppm")) {
+		printUsage();
+		return false;
+	}
+	settings.input = positional[0];
+	settings.output = positional[1];
+	return true;
+}
+
+//--------------------------------------------------------------
+int runStillRender(const StillRenderSettings& settings) {
+
+	EffectChain effectChain;
+	std::stringstream effects(settings.effect);
+	std::string effect;
+	while (std::getline(effects, effect, ',')) {
+		if (!effectChain.append(effect)) {
+			std::cerr << "unknown effect " << effect << "\n";
+			printUsage();
+			return 1;
+		}
+	}
+
+	StillSource input;
+	if (!input.open(settings.input)) {
+		std::cerr << "cannot read " << settings.input << "\n";
+		return 1;
+	}
+	int rows = input.getRows();
+	int cols = input.getCols();
+	StillSource overlay;
+	bool useOverlay = !settings.overlay.empty();
+	if (useOverlay && (!overlay.open(settings.overlay) || overlay.getRows() != rows || overlay.getCols() != cols)) {
+		std::cerr << "cannot read " << settings.overlay << " at " << cols << "x" << rows << "\n";
+		return 1;
+	}
+	if (!input.isMapped() || (useOverlay && !overlay.isMapped())) {
+		std::cerr << "only binary PPM is read in strips, other images are decoded whole beyond the memory budget\n";
+	}
+
+	uint64_t baseSeed = settings.hasSeed ? settings.seed : std::random_device()();
+	std::cout << "seed " << baseSeed << "\n";
+	ThreadPool threadPool(settings.threads ? settings.threads : std::thread::hardware_concurrency());
+	setPostprocessPool(&threadPool);
+	setMotionMap(nullptr);
+	setPixelScale(settings.pixelScale);
+	//The seed of frame 0 of an offline render.
+	setFrameSeed(deriveFrameSeed(baseSeed, 0));
+	effectChain.prepare(rows, cols, settings.intensity);
+	int reach = effectChain.getRowReach();
+
+	//The budget holds a chunk of mapped rows per input, the input window of a strip with its halo rows, the chain's
+	//scratch window when there are several stages, and the output strip.
+	size_t rowBytes = size_t(cols) * 3;
+	size_t budget = settings.memoryMB << 20;
+	size_t inputs = useOverlay ? 2 : 1;
+	size_t chunkRows = std::min<size_t>(rows, std::max<size_t>(1, budget / 8 / (rowBytes * inputs)));
+	size_t budgetRows = (budget - std::min(budget, chunkRows * inputs * rowBytes)) / rowBytes;
+	size_t windows = effectChain.size() > 1 ? 2 : 1;
+	size_t haloRows = 2 * size_t(reach);
+	if (budgetRows < windows * (1 + haloRows) + 1) {
+		size_t needed = ((windows * (1 + haloRows) + 1) * rowBytes / 7 * 8 >> 20) + 1;
+		std::cerr << "a " << cols << " pixel wide strip with " << reach << " halo rows needs --memory " << needed << " at least\n";
+		setPostprocessPool(nullptr);
+		return 1;
+	}
+	int stripRows = int(std::min<size_t>(rows, (budgetRows - windows * haloRows) / (windows + 1)));
+
+	std::ofstream output(settings.output, std::ios::binary);
+	if (!output) {
+		std::cerr << "cannot write " << settings.output << "\n";
+		setPostprocessPool(nullptr);
+		return 1;
+	}
+	output << "P6\n" << cols << " " << rows << "\n255\n";
+
+	auto start = std::chrono::steady_clock::now();
+	Mat window(stripRows + reach * 2, cols, CV_8UC3);
+	Mat strip(stripRows, cols, CV_8UC3);
+	int strips = (rows + stripRows - 1) / stripRows;
+	bool failed = false;
+	for (int rowBegin = 0, index = 0; rowBegin < rows && !failed; rowBegin += stripRows, index++) {
+		int rowEnd = std::min(rows, rowBegin + stripRows);
+		//The last strip uses the front of the buffers.
+		Mat windowView(rowEnd - rowBegin + reach * 2, cols, CV_8UC3, window.data);
+		Mat stripView(rowEnd - rowBegin, cols, CV_8UC3, strip.data);
+		if (!fillWindow(windowView, rowBegin - reach, input, useOverlay ? &overlay : nullptr, settings.alphaCam, int(chunkRows))) {
+			std::cerr << "\ncannot read rows " << rowBegin << " to " << rowEnd << " of " << settings.input << "\n";
+			failed = true;
+			break;
+		}
+		effectChain.processStrip(stripView, windowView, rowBegin, rowEnd);
+		output.write(reinterpret_cast<const char*>(stripView.data), std::streamsize(rowBytes * (rowEnd - rowBegin)));
+		if (!output) {
+			std::cerr << "\ncannot write " << settings.output << "\n";
+			failed = true;
+		}
+		std::cout << "\rstrip " << index + 1 << " / " << strips << std::flush;
+	}
+	output.close();
+	setPostprocessPool(nullptr);
+	if (failed) {
+		return 1;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	size_t bufferBytes = (windows * window.rows + strip.rows + chunkRows * inputs) * rowBytes;
+	std::cout << "\nrendered " << cols << "x" << rows << " in " << strips << " strips of " << stripRows << " rows and "
+		<< reach << " halo rows, " << (bufferBytes >> 20) << " MB of buffers, in " << seconds << "s\n";
+	return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+//Headless glitch of stills larger than memory, such as print size posters. The image goes through in horizontal
+//strips, each read with the halo rows the effects reach into above and below it (splitRGB2, sand), processed by the
+//same stages as the app and written out before the next one is read. Peak memory is capped by a budget, whatever
+//the image height, and the output is the same as processing the whole image at once.
+//Binary PPM (P6) inputs are memory mapped a few rows at a time, other formats are decoded whole first, which
+//the budget cannot cover. The output is a binary PPM, written strip by strip.
+struct StillRenderSettings {
+	std::string input;
+	//.ppm
+	std::string output;
+	//Optional image of the input's size, blended over it like the camera over the background in the app.
+	std::string overlay;
+	float alphaCam = 0.3f;
+	//One effect name or a comma separated chain.
+	std::string effect = "splitRGB1";
+	//Stands in for the motion of the app, which a still has none of.
+	float intensity = 1;
+	//The effect offsets are tuned in pixels of the app's background, larger values scale them up for a poster.
+	//Their halo rows grow with it.
+	float pixelScale = 1;
+	//Strip buffers and mapped rows, in MB. The stripe effects keep about 1.5 KB of pattern tables per column on top.
+	size_t memoryMB = 256;
+	//0 means hardware_concurrency.
+	unsigned threads = 0;
+	//Picked at random without one.
+	bool hasSeed = false;
+	uint64_t seed = 0;
+};
+
+//Parses "--still" style arguments, returns false and prints usage on error.
+bool parseStillRenderArgs(int argc, char* argv[], StillRenderSettings& settings);
+
+//Returns a process exit code.
+int runStillRender(const StillRenderSettings& settings);
@@ -0,0 +1,259 @@
+#include "ThreadPool.h"
+#include "AllocationCounter.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+//Slot of the current thread in the pool it belongs to.
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local unsigned currentIndex = 0;
+static thread_local ThreadPool::Level currentLevel = ThreadPool::LEVEL_NORMAL;
+
+//Slot of a thread outside the pool, in the last pool it queued a job in.
+static thread_local uint64_t callerPool = 0;
+static thread_local unsigned callerIndex = 0;
+static thread_local bool callerShared = false;
+
+//Slot the current band runs under, see getTaskSlot().
+static thread_local unsigned taskSlot = 0;
+
+static std::atomic<uint64_t> nextPoolId{ 1 };
+
+//--------------------------------------------------------------
+ThreadPool::ThreadPool(unsigned numThreads) : id(nextPoolId++) {
+	numThreads = std::max(1u, numThreads);
+	for (auto& count : levelPending) {
+		count = 0;
+	}
+	for (unsigned i = 0; i < numThreads + callerSlots - 1; i++) {
+		queues.emplace_back(new Queue());
+		//Enough for a few concurrent jobs, more only grows the lane once.
+		for (auto& lane : queues.back()->lanes) {
+			lane.tasks.reserve(256);
+		}
+	}
+	for (unsigned i = 1; i < numThreads; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+//--------------------------------------------------------------
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		stopping = true;
+	}
+	wakeCondition.notify_all();
+	for (auto& entry : workers) {
+		entry.join();
+	}
+}
+
+//--------------------------------------------------------------
+void ThreadPool::run(int begin, int end, int grain, const RangeFunc& func) {
+	if (end <= begin) {
+		return;
+	}
+	int count = end - begin;
+	if (grain <= 0) {
+		//A few chunks per thread, so that idle threads have something left to steal.
+		grain = std::max(1, count / int(size() * 4));
+	}
+	int chunks = (count + grain - 1) / grain;
+	unsigned self = currentPool == this ? currentIndex : getCallerSlot();
+	if (chunks == 1 || size() == 1) {
+		//Nobody else runs bands of this job.
+		taskSlot = self;
+		func(begin, end);
+		return;
+	}
+
+	int level = currentLevel;
+	const char* zone = getProfileZone();
+	Join join;
+	join.remaining = chunks;
+	for (int i = 0; i < chunks; i++) {
+		Task task;
+		task.func = &func;
+		task.begin = begin + i * grain;
+		task.end = std::min(end, task.begin + grain);
+		task.join = &join;
+		task.zone = zone;
+		//One chunk per round on the caller's own queue, the others on the workers'. Other callers may be asleep.
+		unsigned offset = i % size();
+		Queue& queue = *queues[offset == 0 ? self : offset];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.lanes[level].tasks.push_back(task);
+	}
+	levelPending[level] += chunks;
+	pending += chunks;
+	{
+		//Pairs with the predicate check in workerLoop so that no wake up is lost.
+		std::lock_guard<std::mutex> lock(wakeMutex);
+	}
+	wakeCondition.notify_all();
+
+	//The caller works too, and sleeps once every band left is taken.
+	bool helps = currentPool == this || !callerShared;
+	while (helps && tryRunOne(self, level)) {
+	}
+	auto idleStart = std::chrono::steady_clock::now();
+	{
+		std::unique_lock<std::mutex> lock(join.mutex);
+		join.condition.wait(lock, [&join] { return join.remaining == 0; });
+	}
+	auto idle = std::chrono::steady_clock::now() - idleStart;
+	queues[self]->idleNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(idle).count(), std::memory_order_relaxed);
+}
+
+//The first caller takes slot 0, the next ones the slots after the workers, past callerSlots they share them.
+unsigned ThreadPool::getCallerSlot() {
+	if (callerPool != id) {
+		unsigned caller = nextCaller++;
+		callerPool = id;
+		callerShared = caller >= callerSlots;
+		caller %= callerSlots;
+		callerIndex = caller == 0 ? 0 : size() - 1 + caller;
+	}
+	return callerIndex;
+}
+
+//--------------------------------------------------------------
+unsigned ThreadPool::getTaskSlot() {
+	return taskSlot;
+}
+
+//--------------------------------------------------------------
+void ThreadPool::setThreadLevel(Level level) {
+	currentLevel = level;
+}
+
+//--------------------------------------------------------------
+ThreadPool::Level ThreadPool::getThreadLevel() {
+	return currentLevel;
+}
+
+//--------------------------------------------------------------
+std::vector<ThreadPool::WorkerStats> ThreadPool::getStats() const {
+	std::vector<WorkerStats> stats(queues.size());
+	for (size_t i = 0; i < queues.size(); i++) {
+		stats[i].tasksRun = queues[i]->tasksRun;
+		stats[i].tasksStolen = queues[i]->tasksStolen;
+		stats[i].idleSeconds = queues[i]->idleNanos * 1e-9;
+	}
+	return stats;
+}
+
+//--------------------------------------------------------------
+void ThreadPool::resetStats() {
+	for (auto& queue : queues) {
+		queue->tasksRun = 0;
+		queue->tasksStolen = 0;
+		queue->idleNanos = 0;
+	}
+}
+
+//Own queue is consumed from the front, which keeps neighbouring bands on the same core.
+bool ThreadPool::popLocal(unsigned index, int level, Task& task) {
+	Queue& queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	Lane& lane = queue.lanes[level];
+	if (lane.head == lane.tasks.size()) {
+		return false;
+	}
+	task = lane.tasks[lane.head++];
+	if (lane.head == lane.tasks.size()) {
+		lane.tasks.clear();
+		lane.head = 0;
+	}
+	return true;
+}
+
+//Thieves take from the back, as far away from the owner as possible.
+bool ThreadPool::steal(unsigned thief, int level, Task& task) {
+	for (size_t i = 1; i < queues.size(); i++) {
+		Queue& queue = *queues[(thief + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		Lane& lane = queue.lanes[level];
+		if (lane.head != lane.tasks.size()) {
+			task = lane.tasks.back();
+			lane.tasks.pop_back();
+			if (lane.head == lane.tasks.size()) {
+				lane.tasks.clear();
+				lane.head = 0;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+//Levels are tried in order, a task of a more urgent level anywhere in the pool goes before the local ones.
+bool ThreadPool::tryRunOne(unsigned index, int maxLevel) {
+	Task task;
+	bool found = false;
+	bool stolen = false;
+	for (int level = 0; level <= maxLevel && !found; level++) {
+		if (levelPending[level].load(std::memory_order_acquire) <= 0) {
+			continue;
+		}
+		if (popLocal(index, level, task)) {
+			found = true;
+		}
+		else if (steal(index, level, task)) {
+			found = stolen = true;
+		}
+		if (found) {
+			levelPending[level]--;
+		}
+	}
+	if (!found) {
+		return false;
+	}
+	pending--;
+
+	{
+		//One band of rows, the trace shows how evenly a pass spreads over the threads.
+		PROFILE_TASK(task.zone, task.begin, task.end);
+		taskSlot = index;
+		(*task.func)(task.begin, task.end);
+	}
+
+	Queue& queue = *queues[index];
+	queue.tasksRun.fetch_add(1, std::memory_order_relaxed);
+	if (stolen) {
+		queue.tasksStolen.fetch_add(1, std::memory_order_relaxed);
+	}
+	{
+		std::lock_guard<std::mutex> lock(task.join->mutex);
+		if (--task.join->remaining == 0) {
+			task.join->condition.notify_one();
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+void ThreadPool::workerLoop(unsigned index) {
+	currentPool = this;
+	currentIndex = index;
+	setProfileThreadName("worker " + std::to_string(index));
+	//Workers only run frame work.
+	countAllocations(true);
+	while (true) {
+		if (tryRunOne(index)) {
+			continue;
+		}
+		auto idleStart = std::chrono::steady_clock::now();
+		{
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wakeCondition.wait(lock, [this] { return stopping || pending > 0; });
+			if (stopping) {
+				return;
+			}
+		}
+		auto idle = std::chrono::steady_clock::now() - idleStart;
+		queues[index]->idleNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(idle).count(), std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Long-lived work-stealing pool. Created once and reused by every frame, so that
+//the per-frame cost is queueing a few row bands instead of spawning threads.
+//Several threads may queue jobs at once (one per stream), each job is queued at the level of the thread that queues it.
+//Idle threads take the most urgent task first, so an urgent stream's bands overtake the normal ones already queued.
+//A thread outside the pool helps with its own job until none of it is left to take, then sleeps until the last
+//band ran, so the callers never add busy threads on top of the workers.
+class ThreadPool {
+
+	public:
+		//Scheduling levels, the lower the more urgent. Threads queue at LEVEL_NORMAL until they set another one.
+		enum Level {
+			LEVEL_URGENT,
+			LEVEL_HIGH,
+			LEVEL_NORMAL,
+			LEVEL_LOW,
+			LEVEL_COUNT,
+		};
+
+		//Range body, receives [begin, end). Refers to the caller's callable without copying it,
+		//so that queueing a job never allocates.
+		struct RangeFunc {
+			const void* body;
+			void (*invoke)(const void* body, int begin, int end);
+			void operator()(int begin, int end) const { invoke(body, begin, end); }
+		};
+
+		struct WorkerStats {
+			uint64_t tasksRun = 0;
+			uint64_t tasksStolen = 0;
+			double idleSeconds = 0;
+		};
+
+		//numThreads counts the calling thread, which helps with its own jobs unless it is on a shared slot.
+		explicit ThreadPool(unsigned numThreads = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		//Level of the jobs the calling thread queues from now on, in any pool.
+		static void setThreadLevel(Level level);
+		static Level getThreadLevel();
+
+		//Total number of threads taking part in a parallelFor, caller included.
+		unsigned size() const { return unsigned(workers.size()) + 1; }
+		//Number of slots, see getStats().
+		unsigned getSlotCount() const { return unsigned(queues.size()); }
+		//Slot the calling thread runs its current band under, inside a parallelFor body. No two threads run bands
+		//of the same job under one slot at once, so per slot scratch needs no locking.
+		static unsigned getTaskSlot();
+
+		//Splits [begin, end) into chunks of grain items, spreads them over the worker queues
+		//and blocks until all of them ran. grain <= 0 picks a chunk size from the pool size.
+		template<class Func>
+			void parallelFor(int begin, int end, int grain, const Func& func) {
+				RangeFunc range = { &func, [](const void* body, int begin, int end) { (*static_cast<const Func*>(body))(begin, end); } };
+				run(begin, end, grain, range);
+			};
+
+		//Index 0 is the slot of the first calling thread, 1 to size() - 1 are the workers and the ones after them
+		//the slots of further callers. A caller's idle time is the time it slept on its jobs.
+		std::vector<WorkerStats> getStats() const;
+		void resetStats();
+
+	private:
+		//Threads outside the pool that get a slot of their own, more share them. A caller on a shared slot only
+		//queues and sleeps, it never runs a band under a slot another thread may be running one under.
+		static const unsigned callerSlots = 8;
+
+		//One per run(), on the caller's stack. Counted down under the mutex, so that the caller cannot return
+		//while the last band still touches it.
+		struct Join {
+			int remaining = 0;
+			std::mutex mutex;
+			std::condition_variable condition;
+		};
+
+		struct Task {
+			const RangeFunc* func;
+			int begin;
+			int end;
+			Join* join;
+			//Profile zone that queued the task.
+			const char* zone;
+		};
+
+		//Tasks [head, size) are queued. Drained lanes are cleared, which keeps their capacity,
+		//so a steady frame rate never reallocates them.
+		struct Lane {
+			std::vector<Task> tasks;
+			size_t head = 0;
+		};
+
+		//One lane per level.
+		struct Queue {
+			std::mutex mutex;
+			Lane lanes[LEVEL_COUNT];
+			std::atomic<uint64_t> tasksRun{ 0 };
+			std::atomic<uint64_t> tasksStolen{ 0 };
+			std::atomic<uint64_t> idleNanos{ 0 };
+		};
+
+		void run(int begin, int end, int grain, const RangeFunc& func);
+		//Slot of the calling thread, assigned on its first job when it is not a worker.
+		unsigned getCallerSlot();
+		bool popLocal(unsigned index, int level, Task& task);
+		bool steal(unsigned thief, int level, Task& task);
+		//Most urgent task down to maxLevel. A caller waiting on its own job only helps with jobs at least as
+		//urgent, a lower one could hold it back.
+		bool tryRunOne(unsigned index, int maxLevel = LEVEL_COUNT - 1);
+		void workerLoop(unsigned index);
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+		//Tells this pool's caller slots from those of a pool destroyed before at the same address.
+		const uint64_t id;
+		std::atomic<unsigned> nextCaller{ 0 };
+
+		std::mutex wakeMutex;
+		std::condition_variable wakeCondition;
+		std::atomic<int> pending{ 0 };
+		//Queued tasks per level, lets a thread skip the empty levels without taking a lock.
+		std::atomic<int> levelPending[LEVEL_COUNT];
+		bool stopping = false;
+};
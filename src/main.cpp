@@ -1,13 +1,65 @@
+#ifndef GLITCH_HEADLESS
 #include "ofMain.h"
 #include "ofApp.h"
+#endif
+#include "BatchRenderer.h"
+#include "StillRenderer.h"
+#include "Benchmark.h"
+#include "RegressionCheck.h"
+
+#include <iostream>
+#include <string>
 
 //========================================================================
-int main( ){
+int main(int argc, char* argv[]){
+
+	//Offline rendering, benchmarks and the regression check never open a window.
+	if (argc > 1 && std::string(argv[1]) == "--render") {
+		BatchRenderSettings settings;
+		if (!parseBatchRenderArgs(argc, argv, settings)) {
+			return 1;
+		}
+		return runBatchRender(settings);
+	}
+	if (argc > 1 && std::string(argv[1]) == "--still") {
+		StillRenderSettings settings;
+		if (!parseStillRenderArgs(argc, argv, settings)) {
+			return 1;
+		}
+		return runStillRender(settings);
+	}
+	if (argc > 1 && std::string(argv[1]) == "--bench") {
+		BenchmarkSettings settings;
+		if (!parseBenchmarkArgs(argc, argv, settings)) {
+			return 1;
+		}
+		return runBenchmark(settings);
+	}
+	if (argc > 1 && std::string(argv[1]) == "--check") {
+		RegressionSettings settings;
+		if (!parseRegressionArgs(argc, argv, settings)) {
+			return 1;
+		}
+		return runRegressionCheck(settings);
+	}
+
+#ifdef GLITCH_HEADLESS
+	//The headless build (CMakeLists.txt) has no window, camera or GUI.
+	std::cerr << "usage: InteractiveGlitchArtPostprocessing --render|--still|--bench|--check ...\n";
+	return 1;
+#else
+	//Several screens from one process: "--stream <background> <input> [options]" once per screen.
+	std::vector<StreamSettings> streams(1);
+	if (argc > 1 && std::string(argv[1]) == "--stream" && !parseStreamArgs(argc, argv, streams)) {
+		return 1;
+	}
+
 	ofSetupOpenGL(1920,1080,OF_WINDOW);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
 	// can be OF_WINDOW or OF_FULLSCREEN
 	// pass in width and height too:
-	ofRunApp(new ofApp());
+	ofRunApp(new ofApp(streams));
+#endif
 
 }
@@ -1,36 +1,58 @@
 #include "ofApp.h"
 
-//Multi-threading. The bottleneck of this program is iterating each pixel per frame,
-//which could be highly optimized by software concurrency.
-static uint64 countPerThread;
-static uint64 numThreads = std::thread::hardware_concurrency();
-
-//Declaration of processing funtions
-#define DECLARE_POSTPROCESS(func) void func(Mat&, const Mat&, float)
-DECLARE_POSTPROCESS(splitRGB1);
-DECLARE_POSTPROCESS(splitRGB2);
-DECLARE_POSTPROCESS(block1);
-DECLARE_POSTPROCESS(block2);
-DECLARE_POSTPROCESS(sand);
-DECLARE_POSTPROCESS(scanLine); 
-DECLARE_POSTPROCESS(digitalStripe);
-DECLARE_POSTPROCESS(intDigitalStripe);
+//GL2 shaders putting the three planes of a planar frame back together, on rectangle textures like every ofTexture.
+static const char* planesVertexShader = R"(
+#version 120
+void main() {
+	gl_TexCoord[0] = gl_MultiTexCoord0;
+	gl_Position = ftransform();
+}
+)";
+
+static const char* planesFragmentShader = R"(
+#version 120
+#extension GL_ARB_texture_rectangle : enable
+uniform sampler2DRect planeRed;
+uniform sampler2DRect planeGreen;
+uniform sampler2DRect planeBlue;
+void main() {
+	vec2 position = gl_TexCoord[0].st;
+	gl_FragColor = vec4(texture2DRect(planeRed, position).r, texture2DRect(planeGreen, position).r, texture2DRect(planeBlue, position).r, 1.0);
+}
+)";
 
 //--------------------------------------------------------------
 void ofApp::setup(){
-	//The image merged in the program.
-	img.load("cyber.png");
-	img.setImageType(OF_IMAGE_COLOR);
-	matImg = toCv(img);
-	//Multi-threading context determined at run time.
-	countPerThread = (matImg.cols * matImg.rows) / numThreads;
-	//Result show on screen
-	matResult = Mat(matImg.rows, matImg.cols, CV_8UC3);
-
-	videoGrabber.setup(img.getWidth(), img.getHeight());
+	//Multi-threading context determined at run time, one pool for every stream so that the cores are not oversubscribed.
+	threadPool.reset(new ThreadPool());
+	setPostprocessPool(threadPool.get());
+	shaderPlanes.setupShaderFromSource(GL_VERTEX_SHADER, planesVertexShader);
+	shaderPlanes.setupShaderFromSource(GL_FRAGMENT_SHADER, planesFragmentShader);
+	shaderPlanes.linkProgram();
+
+	//Streams whose background does not load are left out.
+	float width = 0;
+	float height = 0;
+	for (size_t i = 0; i < streamSettings.size(); i++) {
+		std::unique_ptr<GlitchStream> stream(new GlitchStream());
+		if (stream->setup(streamSettings[i], streamSettings.size() > 1 ? std::to_string(i) : "")) {
+			width += stream->getWidth();
+			height = std::max(height, stream->getHeight());
+			streams.push_back(std::move(stream));
+		}
+	}
+	if (streams.empty()) {
+		ofExit(1);
+		return;
+	}
+	//Side by side, a window spanning the screens of the installation.
+	if (streams.size() > 1) {
+		ofSetWindowShape(width, height);
+	}
 
 	gui.setup();
 	
+	sliderStream.addListener(this, &ofApp::streamChanged);
 	btnRGBSplit1.addListener(this, &ofApp::setPostProcessMethod<splitRGB1>);
 	btnRGBSplit2.addListener(this, &ofApp::setPostProcessMethod<splitRGB2>);
 	btnSand.addListener(this, &ofApp::setPostProcessMethod<sand>);
@@ -39,8 +61,26 @@ void ofApp::setup(){
 	btnBlock2.addListener(this, &ofApp::setPostProcessMethod<block2>);
 	btnDigitalSprite.addListener(this, &ofApp::setPostProcessMethod<digitalStripe>);
 	btnIntDigitalSprite.addListener(this, &ofApp::setPostProcessMethod<intDigitalStripe>);
-
-	gui.add(alphaCam.setup("Alpha", 0.3, 0, 1));
+	btnTimeScanLine.addListener(this, &ofApp::setPostProcessMethod<timeScanLine>);
+	btnFreezeBlock.addListener(this, &ofApp::setPostProcessMethod<freezeBlock>);
+	sliderHistory.addListener(this, &ofApp::historyChanged);
+	btnClearChain.addListener(this, &ofApp::clearChain);
+	sliderPipelineDepth.addListener(this, &ofApp::pipelineDepthChanged);
+	sliderMaskScale.addListener(this, &ofApp::maskScaleChanged);
+	toggleAdaptive.addListener(this, &ofApp::adaptiveChanged);
+	sliderBudget.addListener(this, &ofApp::budgetChanged);
+	togglePlanar.addListener(this, &ofApp::planarChanged);
+	sliderPriority.addListener(this, &ofApp::priorityChanged);
+	sliderDeadline.addListener(this, &ofApp::deadlineChanged);
+	toggleRecord.addListener(this, &ofApp::recordChanged);
+	toggleProfiler.addListener(this, &ofApp::profilerChanged);
+	btnDumpTrace.addListener(this, &ofApp::dumpTrace);
+
+	//Stream the per stream controls below edit: alpha, effects, history, chain, priority and deadline.
+	if (streams.size() > 1) {
+		gui.add(sliderStream.setup("Stream", 0, 0, int(streams.size()) - 1));
+	}
+	gui.add(alphaCam.setup("Alpha", getStream().getAlphaCam(), 0, 1));
 	gui.add(btnRGBSplit1.setup("RGB Split V1"));
 	gui.add(btnRGBSplit2.setup("RGB Split V2"));
 	gui.add(btnScanLine.setup("Scan Line"));
@@ -49,419 +89,208 @@ void ofApp::setup(){
 	gui.add(btnBlock2.setup("Block V2"));
 	gui.add(btnDigitalSprite.setup("Digital Stripe"));
 	gui.add(btnIntDigitalSprite.setup("Intermidiate Stripe"));
-
-	_Postprocess = splitRGB1;
-}
-
-//--------------------------------------------------------------
-void ofApp::update(){
-	
-	videoGrabber.update();
-
-	if (videoGrabber.isFrameNew()) {
-
-		ofImage imgCam = videoGrabber.getPixels();
-		Mat matCam = toCv(imgCam);
-		//Intermidiate result of merging real-world and provided image, will apply postprocess later
-		Mat matMerge(matImg.rows, matImg.cols, CV_8UC3);
-
-		//To roughly record per frame difference, atomic is for thread safe.
-		std::atomic<uint64> differentCount = 0;
-		cvtColor(matCam, matMask, cv::COLOR_RGB2GRAY);
-		threshold(matMask, matMask, 0, 255, CV_THRESH_BINARY | CV_THRESH_OTSU);
-		if (matMaskPre.empty()) {
-			matMask.copyTo(matMaskPre);
-		}
-
-		//What below does is merging two images and record difference between previous frame.
-		//Just use bare threads here.
-		std::vector<std::thread> threads(numThreads - 1);
-		for (uint64 i = 0; i < numThreads - 1; i++) {
-
-			auto f = [=, &differentCount] {
-				for (uint64 j = i * countPerThread; j < (i + 1) * countPerThread; j++) {
-					matMerge.data[j * 3] = matImg.data[j * 3] * (1 - alphaCam) + matCam.data[j * 3] * alphaCam;
-					matMerge.data[j * 3 + 1] = matImg.data[j * 3 + 1] * (1 - alphaCam) + matCam.data[j * 3 + 1] * alphaCam;
-					matMerge.data[j * 3 + 2] = matImg.data[j * 3 + 2] * (1 - alphaCam) + matCam.data[j * 3 + 2] * alphaCam;
-					if (matMask.data[j] != matMaskPre.data[j]) {
-						differentCount++;
-						matMaskPre.data[j] = matMask.data[j];
-					}
-				}
-			};
-			threads[i] = std::thread(f);
-		}
-		for (uint64 j = (numThreads - 1) * countPerThread; j < numThreads * countPerThread; j++) {
-			matMerge.data[j * 3] = matImg.data[j*3] * (1 - alphaCam) + matCam.data[j * 3] * alphaCam;
-			matMerge.data[j * 3 + 1] = matImg.data[j*3+1] * (1 - alphaCam) + matCam.data[j * 3 + 1] * alphaCam;
-			matMerge.data[j * 3 + 2] = matImg.data[j*3+2] * (1 - alphaCam) + matCam.data[j * 3 + 2] * alphaCam;
-			if (matMask.data[j] != matMaskPre.data[j]) {
-				differentCount++;
-				matMaskPre.data[j] = matMask.data[j];
-			}
-		}
-		for (auto& entry : threads) {
-			entry.join();
-		}
-		
-		//Process to get final result.
-		float intensity =  float(differentCount)/float(matImg.cols * matImg.rows);
-		_Postprocess(matResult, matMerge, intensity);
-		
+	gui.add(btnTimeScanLine.setup("Time Scan Line"));
+	gui.add(btnFreezeBlock.setup("Freeze Block"));
+	//Each frame of history is one more frame pool slot, see Pipeline Stats for its memory.
+	gui.add(sliderHistory.setup("History Frames", getStream().getPipeline().getHistoryDepth(), 0, 8));
+	gui.add(toggleChain.setup("Chain Effects", getStream().getUseChain()));
+	gui.add(btnClearChain.setup("Clear Chain"));
+	gui.add(labelChain.setup("Chain", getStream().describeChain()));
+	gui.add(togglePoolStats.setup("Pool Stats", false));
+	gui.add(labelSeed.setup("Seed", getStream().describeSeed()));
+	//1 keeps a single frame in flight for the lowest latency, 3 overlaps every stage for throughput.
+	gui.add(sliderPipelineDepth.setup("Pipeline Depth", 3, 1, 3));
+	gui.add(togglePipelineStats.setup("Pipeline Stats", false));
+	//The mask only drives the intensity, a half or quarter size mask is usually enough.
+	gui.add(sliderMaskScale.setup("Mask Scale", 1, 1, 4));
+	//Lowers the processing size while analyze + glitch miss the budget, the result is scaled up on the GPU.
+	gui.add(toggleAdaptive.setup("Adaptive Resolution", false));
+	gui.add(sliderBudget.setup("Frame Budget ms", 16.6, 8, 50));
+	//RGB Split and Block run on separate color planes, the other effects are not affected.
+	gui.add(togglePlanar.setup("Planar Layout", false));
+	if (streams.size() > 1) {
+		//1 high, 2 normal, 3 low: the pool runs the bands of a higher stream first.
+		gui.add(sliderPriority.setup("Priority", getStream().getPipeline().getPriority(), ThreadPool::LEVEL_HIGH, ThreadPool::LEVEL_LOW));
+		//Frames about to miss it, capture to glitched, jump ahead of every other stream. 0 is none.
+		gui.add(sliderDeadline.setup("Deadline ms", getStream().getPipeline().getDeadlineMs(), 0, 100));
 	}
+	//0 mp4 video, 1 raw Y4M, 2 PNG sequence, all in the data folder. Frames the writers cannot keep up with are
+	//left out of the recording, the screen never waits for them.
+	gui.add(toggleRecord.setup("Record", false));
+	gui.add(sliderRecordFormat.setup("Record Format", 0, 0, 2));
+	//Rolling mean / p99 of every profiled zone and how busy each thread is.
+	gui.add(toggleProfiler.setup("Profiler", false));
+	gui.add(sliderTraceFrames.setup("Trace Frames", 120, 10, 600));
+	//Chrome trace_event JSON of the next frames in the data folder, open it in chrome://tracing or ui.perfetto.dev.
+	gui.add(btnDumpTrace.setup("Dump Trace"));
+	setProfileThreadName("main");
 }
 
-//--------------------------------------------------------------
-void ofApp::draw(){
-	drawMat(matResult, 0, 0);
-	gui.draw();
+//Shows the settings of the newly selected stream.
+void ofApp::streamChanged(int& index) {
+	GlitchStream& stream = getStream();
+	alphaCam = stream.getAlphaCam();
+	toggleChain = stream.getUseChain();
+	labelChain = stream.describeChain();
+	sliderHistory = stream.getPipeline().getHistoryDepth();
+	sliderPriority = int(stream.getPipeline().getPriority());
+	sliderDeadline = float(stream.getPipeline().getDeadlineMs());
+	toggleRecord = stream.getRecorder().isRecording();
 }
 
-//Seperate rgb channel horizontally.
-void splitRGB1(Mat& OutResult, const Mat& InMat, float intensity) {
-
-	std::vector<std::thread> threads(numThreads - 1);
-	int splitAmount = 250 * intensity * ofRandomuf();
-	for (int i = 0; i < numThreads - 1; i++) {
-		auto f = [=] {
-			for (int j =  i * countPerThread; j < (i + 1) * countPerThread; j++) {
-				
-				OutResult.data[3 * j]     = InMat.data[(((j % InMat.cols + splitAmount) % InMat.cols + (j / InMat.cols) * InMat.cols) * 3)];
-				OutResult.data[3 * j + 1] = InMat.data[j * 3 + 1];
-				OutResult.data[3 * j + 2] = InMat.data[(((j % InMat.cols - splitAmount + InMat.cols) % InMat.cols + (j / InMat.cols) * InMat.cols) * 3) + 2];
-			}
-		};
-		threads[i] = std::thread(f);
-	}
-	for (int j = (numThreads - 1) * countPerThread; j < InMat.cols * InMat.rows; j++) {
-		
-		OutResult.data[3 * j] = InMat.data[(((j % InMat.cols + splitAmount) % InMat.cols + (j / InMat.cols) * InMat.cols) * 3)];
-		OutResult.data[3 * j + 1] = InMat.data[j * 3 + 1];
-		OutResult.data[3 * j + 2] = InMat.data[(((j % InMat.cols - splitAmount + InMat.cols) % InMat.cols + (j / InMat.cols) * InMat.cols) * 3) + 2];
-	}
-	for (auto& entry : threads) {
-		entry.join();
-	}
-}
-
-//Seperate rgb channel both horithontally and vertically
-void splitRGB2(Mat& OutResult, const Mat& InMat, float intensity) {
-
-	std::vector<std::thread> threads(numThreads - 1);
-	int splitAmount = 250 * intensity * ofRandomuf();
-	for (int i = 0; i < numThreads - 1; i++) {
-		auto f = [=] {
-			for (int j = i * countPerThread; j < (i + 1) * countPerThread; j++) {
-
-				OutResult.data[3 * j] = InMat.data[(((j % InMat.cols + splitAmount) % InMat.cols + (j / InMat.cols + splitAmount) % InMat.rows * InMat.cols) * 3)];
-				OutResult.data[3 * j + 1] = InMat.data[j * 3 + 1];
-				OutResult.data[3 * j + 2] = InMat.data[(((j % InMat.cols - splitAmount + InMat.cols) % InMat.cols + (j / InMat.cols + splitAmount) % InMat.rows * InMat.cols) * 3) + 2];
-			}
-		};
-		threads[i] = std::thread(f);
+//--------------------------------------------------------------
+void ofApp::recordChanged(bool& enabled) {
+	GlitchStream& stream = getStream();
+	if (enabled == stream.getRecorder().isRecording()) {
+		return;
 	}
-	for (int j = (numThreads - 1) * countPerThread; j < InMat.cols * InMat.rows; j++) {
-
-		OutResult.data[3 * j] = InMat.data[(((j % InMat.cols + splitAmount) % InMat.cols + (j / InMat.cols + splitAmount) % InMat.rows * InMat.cols) * 3)];
-		OutResult.data[3 * j + 1] = InMat.data[j * 3 + 1];
-		OutResult.data[3 * j + 2] = InMat.data[(((j % InMat.cols - splitAmount + InMat.cols) % InMat.cols + (j / InMat.cols + splitAmount) % InMat.rows * InMat.cols) * 3) + 2];
+	if (!enabled) {
+		stream.stopRecording();
+		return;
 	}
-	for (auto& entry : threads) {
-		entry.join();
+	static const char* extensions[] = { ".mp4", ".y4m", "_%05d.png" };
+	std::string name = stream.getName().empty() ? "" : stream.getName() + "_";
+	std::string path = ofToDataPath("record_" + name + ofGetTimestampString() + extensions[std::max(0, std::min(2, int(sliderRecordFormat)))]);
+	//Cameras deliver about 30 frames per second.
+	if (!stream.startRecording(path, 30)) {
+		ofLogError("ofApp", "cannot record to " + path);
+		toggleRecord = false;
 	}
 }
 
-//Each row takes a random offset to generate such an effect.
-void scanLine(Mat& OutResult, const Mat& InMat, float intensity) {
-
-	std::vector<std::thread> threads(numThreads - 1);
-	for (int i = 0; i < numThreads - 1; i++) {
-		auto f = [=] {
-			float jitter = ofRandomuf();
-			int row = 0;
-			for (int j = i * countPerThread; j < (i + 1) * countPerThread; j++) {
-				if (j / InMat.cols != row) {
-					jitter = ofRandomuf();
-					row = j / InMat.cols;
-				}
-				int splitAmount = 250 * intensity *  (jitter * 2 - 1);
-				OutResult.data[3 * j]	  = InMat.data[(((j % InMat.cols + splitAmount + InMat.cols) % InMat.cols + (j / InMat.cols) * InMat.cols) * 3)];
-				OutResult.data[3 * j + 1] = InMat.data[(((j % InMat.cols + splitAmount + InMat.cols) % InMat.cols + (j / InMat.cols) * InMat.cols) * 3) + 1];
-				OutResult.data[3 * j + 2] = InMat.data[(((j % InMat.cols + splitAmount + InMat.cols) % InMat.cols + (j / InMat.cols) * InMat.cols) * 3) + 2];
-			}
-		};
-		threads[i] = std::thread(f);
-	}
-
-	float jitter = ofRandomuf();
-	int row = 0;
-	for (int j = (numThreads - 1) * countPerThread; j < InMat.cols * InMat.rows; j++) {
-		
-		if (j / InMat.cols != row) {
-			jitter = ofRandomuf();
-			row = j / InMat.cols;
-		}
-		int splitAmount = 250 * intensity * (jitter * 2 - 1);
-		OutResult.data[3 * j]	  = InMat.data[(((j % InMat.cols + splitAmount + InMat.cols) % InMat.cols + (j / InMat.cols) * InMat.cols) * 3)];
-		OutResult.data[3 * j + 1] = InMat.data[(((j % InMat.cols + splitAmount + InMat.cols) % InMat.cols + (j / InMat.cols) * InMat.cols) * 3) + 1];
-		OutResult.data[3 * j + 2] = InMat.data[(((j % InMat.cols + splitAmount + InMat.cols) % InMat.cols + (j / InMat.cols) * InMat.cols) * 3) + 2];
-	}
-
-	for (auto& entry : threads) {
-		entry.join();
+//--------------------------------------------------------------
+void ofApp::update(){
+	//Collects the zones of the previous frame, draw() included.
+	profileFrame();
+	if (streams.empty()) {
+		return;
 	}
-}
-
-//Each pixel takes a random two dimensional offset.
-void sand(Mat& OutResult, const Mat& InMat, float intensity) {
-	
-	std::vector<std::thread> threads(numThreads - 1);
-	for (int i = 0; i < numThreads - 1; i++) {
-		auto f = [=] {
-			for (int j = i * countPerThread; j < (i + 1) * countPerThread; j++) {
 
-				int splitAmountX = 250 * intensity * (ofRandomuf() * 2 - 1);
-				int splitAmountY = 250 * intensity * (ofRandomuf() * 2 - 1);
-				OutResult.data[3 * j] = InMat.data[(((j % InMat.cols + splitAmountX + InMat.cols) % InMat.cols     + (j / InMat.cols + splitAmountY + InMat.rows) % InMat.rows * InMat.cols) * 3)];
-				OutResult.data[3 * j + 1] = InMat.data[(((j % InMat.cols + splitAmountX + InMat.cols) % InMat.cols + (j / InMat.cols + splitAmountY + InMat.rows) % InMat.rows * InMat.cols) * 3) + 1];
-				OutResult.data[3 * j + 2] = InMat.data[(((j % InMat.cols + splitAmountX + InMat.cols) % InMat.cols + (j / InMat.cols + splitAmountY + InMat.rows) % InMat.rows * InMat.cols) * 3) + 2];
-			}
-		};
-		threads[i] = std::thread(f);
-	}
-	for (int j = (numThreads - 1) * countPerThread; j < InMat.cols * InMat.rows; j++) {
-		int splitAmountX = 250 * intensity * (ofRandomuf() * 2 - 1);
-		int splitAmountY = 250 * intensity * (ofRandomuf() * 2 - 1);
-		OutResult.data[3 * j] = InMat.data[(((j % InMat.cols + splitAmountX + InMat.cols) % InMat.cols	   + (j / InMat.cols + splitAmountY + InMat.rows) % InMat.rows * InMat.cols) * 3)];
-		OutResult.data[3 * j + 1] = InMat.data[(((j % InMat.cols + splitAmountX + InMat.cols) % InMat.cols + (j / InMat.cols + splitAmountY + InMat.rows) % InMat.rows * InMat.cols) * 3) + 1];
-		OutResult.data[3 * j + 2] = InMat.data[(((j % InMat.cols + splitAmountX + InMat.cols) % InMat.cols + (j / InMat.cols + splitAmountY + InMat.rows) % InMat.rows * InMat.cols) * 3) + 2];
-	}
+	GlitchStream& selected = getStream();
+	selected.setAlphaCam(alphaCam);
+	selected.setUseChain(toggleChain);
 
-	for (auto& entry : threads) {
-		entry.join();
+	for (auto& stream : streams) {
+		stream->update();
 	}
 }
 
-//Each block takes a random rgb split value.
-void block1(Mat& OutResult, const Mat& InMat, float intensity) {
-	
-	int blockCount = 10;
-	int blockWidth = InMat.cols / blockCount;
-	int blockHeight = InMat.rows / blockCount;
-
-	Mat randomNoise(blockCount, blockCount, CV_8UC1);
-
-	for (int i = 0; i < blockCount * blockCount; i++) {
-		randomNoise.data[i] = ofRandomuf() * 255;
-	}
-
-	std::vector<std::thread> threads(numThreads - 1);
-	for (int i = 0; i < numThreads - 1; i++) {
-		auto f = [=] {
-			for (int j = i * countPerThread; j < (i + 1) * countPerThread; j++) {
-				int rowIndex = j / InMat.cols;
-				int columnIndex = j % InMat.cols;
-				float random = randomNoise.data[(rowIndex/blockHeight) * randomNoise.cols + columnIndex / blockWidth];
-				int splitAmount = 5 * intensity * random;
-				OutResult.data[3 * j] = InMat.data[((columnIndex + splitAmount + InMat.cols)%InMat.cols + rowIndex * InMat.cols) * 3];
-				OutResult.data[3 * j + 1] = InMat.data[j * 3 + 1];
-				OutResult.data[3 * j + 2] = InMat.data[((columnIndex - splitAmount + InMat.cols) % InMat.cols + rowIndex * InMat.cols) * 3 + 2];
-			}
-		};
-		threads[i] = std::thread(f);
-	}
-	for (int j =  (numThreads - 1) * countPerThread; j < numThreads * countPerThread; j++) {
-		int rowIndex = j / InMat.cols;
-		int columnIndex = j % InMat.cols;
-		float random = randomNoise.data[(rowIndex / blockHeight) * randomNoise.cols + columnIndex / blockWidth];
-		int splitAmount = 5 * intensity * random;
-		OutResult.data[3 * j] = InMat.data[((columnIndex + splitAmount + InMat.cols) % InMat.cols + rowIndex * InMat.cols) * 3];
-		OutResult.data[3 * j + 1] = InMat.data[j * 3 + 1];
-		OutResult.data[3 * j + 2] = InMat.data[((columnIndex - splitAmount + InMat.cols) % InMat.cols + rowIndex * InMat.cols) * 3 + 2];
+//--------------------------------------------------------------
+void ofApp::draw(){
+	PROFILE_SCOPE("draw");
+	if (streams.empty()) {
+		return;
 	}
-
-	for (auto& entry : threads) {
-		entry.join();
+	float x = 0;
+	for (auto& stream : streams) {
+		stream->draw(x, 0, shaderPlanes);
+		x += stream->getWidth();
 	}
-}
-
-//Add a threhold to previous block, such that can generate random blocks.
-void block2(Mat& OutResult, const Mat& InMat, float intensity) {
-
-	int blockCount = 10;
-	int blockWidth = InMat.cols / blockCount;
-	int blockHeight = InMat.rows / blockCount;
-
-	Mat randomNoise(blockCount, blockCount, CV_8UC1);
-
-	for (int i = 0; i < blockCount * blockCount; i++) {
-		randomNoise.data[i] = ofRandomuf() * 255;
-		if (ofRandomuf() > intensity) {
-			randomNoise.data[i] = 0;
+	GlitchStream& selected = getStream();
+	if (streams.size() > 1) {
+		//Outline of the stream the GUI edits.
+		float selectedX = 0;
+		for (int i = 0; i < sliderStream; i++) {
+			selectedX += streams[i]->getWidth();
 		}
+		ofNoFill();
+		ofDrawRectangle(selectedX, 0, selected.getWidth(), selected.getHeight());
+		ofFill();
 	}
+	labelSeed = selected.describeSeed();
+	gui.draw();
 
-	std::vector<std::thread> threads(numThreads - 1);
-	for (int i = 0; i < numThreads - 1; i++) {
-		auto f = [=] {
-			for (int j = i * countPerThread; j < (i + 1) * countPerThread; j++) {
-				int rowIndex = j / InMat.cols;
-				int columnIndex = j % InMat.cols;
-				float random = randomNoise.data[(rowIndex / blockHeight) * randomNoise.cols + columnIndex / blockWidth];
-				int splitAmount = 5 * intensity * random;
-				OutResult.data[3 * j] = InMat.data[((columnIndex + splitAmount + InMat.cols) % InMat.cols + rowIndex * InMat.cols) * 3];
-				OutResult.data[3 * j + 1] = InMat.data[j * 3 + 1];
-				OutResult.data[3 * j + 2] = InMat.data[((columnIndex - splitAmount + InMat.cols) % InMat.cols + rowIndex * InMat.cols) * 3 + 2];
-			}
-		};
-		threads[i] = std::thread(f);
-	}
-	for (int j = (numThreads - 1) * countPerThread; j < numThreads * countPerThread; j++) {
-		int rowIndex = j / InMat.cols;
-		int columnIndex = j % InMat.cols;
-		float random = randomNoise.data[(rowIndex / blockHeight) * randomNoise.cols + columnIndex / blockWidth];
-		int splitAmount = 5 * intensity * random;
-		OutResult.data[3 * j] = InMat.data[((columnIndex + splitAmount + InMat.cols) % InMat.cols + rowIndex * InMat.cols) * 3];
-		OutResult.data[3 * j + 1] = InMat.data[j * 3 + 1];
-		OutResult.data[3 * j + 2] = InMat.data[((columnIndex - splitAmount + InMat.cols) % InMat.cols + rowIndex * InMat.cols) * 3 + 2];
-	}
-
-	for (auto& entry : threads) {
-		entry.join();
+	float y = gui.getHeight() + 30;
+	const FrameRecorder& recorder = selected.getRecorder();
+	if (recorder.isRecording()) {
+		auto stats = recorder.getStats();
+		ofDrawBitmapStringHighlight("recording " + recorder.getPath() +
+			"  queue " + ofToString(int(stats.depth)) + "/" + ofToString(int(stats.capacity)) +
+			"  written " + ofToString(int(stats.written)) +
+			"  dropped " + ofToString(int(stats.dropped)) +
+			"  errors " + ofToString(int(stats.errors)) +
+			"  write " + ofToString(stats.writeMs, 2) + "ms", 10, y);
+		y += 30;
 	}
-}
-
-//Generate a random color noise image first, then do random selection.
-void intDigitalStripe(Mat& OutResult, const Mat& InMat, float intensity) {
-
-	//generate noise image
-	int rowClusterNum = InMat.rows / 30;
-	Mat noiseMat(InMat.rows / rowClusterNum + 1, InMat.cols, CV_8UC4);
-
-	int glitchRow = 0;
-	int countWidth = 0;
-	int randRed;
-	int randGreen;
-	int randBlue;
-	int alpha;
-
-	for (int i = 0; i < noiseMat.rows; i++) {
-
-		for (int j = 0; j < noiseMat.cols; j++) {
-
-			if (countWidth >= glitchRow) {
-				countWidth = 0;
-				glitchRow = ofRandomuf() * InMat.cols * (1 - intensity);
-				randRed = ofRandomuf() * 255;
-				randGreen = ofRandomuf() * 255;
-				randBlue = ofRandomuf() * 255;
-				alpha = ofRandomuf() > intensity ? 0 : 255;
-			}
-			noiseMat.data[(j + i * noiseMat.cols) * 4] = randRed;
-			noiseMat.data[(j + i * noiseMat.cols) * 4 + 1] = randGreen;
-			noiseMat.data[(j + i * noiseMat.cols) * 4 + 2] = randBlue;
-			noiseMat.data[(j + i * noiseMat.cols) * 4 + 3] = alpha;
-			countWidth++;
+	if (togglePipelineStats) {
+		FramePipeline& pipeline = selected.getPipeline();
+		auto stats = pipeline.getStats();
+		for (int i = 0; i < FramePipeline::STAGE_COUNT; i++) {
+			ofDrawBitmapStringHighlight(std::string(FramePipeline::getStageName(FramePipeline::Stage(i))) +
+				"  mean " + ofToString(stats.stages[i].meanMs, 2) + "ms" +
+				"  p99 " + ofToString(stats.stages[i].p99Ms, 2) + "ms", 10, y);
+			y += 20;
 		}
-	}
-
-	std::vector<std::thread> threads(numThreads - 1);
-	for (int i = 0; i < numThreads - 1; i++) {
-
-		auto f = [=] {
-			for (int j = i * countPerThread; j < (i + 1) * countPerThread; j++) {
-				int alpha = noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4 + 3];
-				OutResult.data[3 * j] = alpha * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4];
-				OutResult.data[3 * j + 1] = alpha * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4 + 1];
-				OutResult.data[3 * j + 2] = alpha * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4 + 2];
-			}
-		};
-		threads[i] = std::thread(f);
-	}
-
-	for (int j = (numThreads - 1) * countPerThread; j < InMat.cols * InMat.rows; j++) {
-		int alpha = noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4 + 3];
-		OutResult.data[3 * j] = alpha * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 3];
-		OutResult.data[3 * j + 1] = alpha * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 3 + 1];
-		OutResult.data[3 * j + 2] = alpha * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 3 + 2];
-	}
-
-	for (auto& entry : threads) {
-		entry.join();
-	}
-}
-
-//Apply the previous generated image to the merged result.
-//This case I do merge and inverse. There could be various visual effect.
-void digitalStripe(Mat& OutResult, const Mat& InMat, float intensity) {
-
-	//generate noise texture
-	int rowClusterNum = InMat.rows / 25;
-	Mat noiseMat(InMat.rows / rowClusterNum + 1, InMat.cols, CV_8UC4);
-	
-	int glitchRow = 0;
-	int countWidth = 0;
-	int randRed;
-	int randGreen;
-	int randBlue;
-	int alpha;
-
-	for (int i = 0; i < noiseMat.rows; i++) {
-		
-		for (int j = 0; j < noiseMat.cols; j++) {
-			
-			if (countWidth >= glitchRow) {
-				countWidth = 0;
-				glitchRow = ofRandomuf() * InMat.cols * (1 - intensity);
-				randRed	  = ofRandomuf() * 255;
-				randGreen = ofRandomuf() * 255;
-				randBlue  = ofRandomuf() * 255;
-				alpha =  ofRandomuf() > intensity ? 0 : 255;
-			}
-			noiseMat.data[(j + i * noiseMat.cols) * 4] = randRed;
-			noiseMat.data[(j + i * noiseMat.cols) * 4 + 1] = randGreen;
-			noiseMat.data[(j + i * noiseMat.cols) * 4 + 2] = randBlue;
-			noiseMat.data[(j + i * noiseMat.cols) * 4 + 3] = alpha;
-			countWidth++;
+		ofDrawBitmapStringHighlight("capture to photon  mean " + ofToString(stats.latency.meanMs, 2) + "ms" +
+			"  p99 " + ofToString(stats.latency.p99Ms, 2) + "ms" +
+			"  dropped " + ofToString(int(stats.dropped)) + "/" + ofToString(int(stats.presented + stats.dropped)), 10, y);
+		y += 20;
+		ofDrawBitmapStringHighlight("processing " + ofToString(stats.cols) + "x" + ofToString(stats.rows) +
+			"  scale " + ofToString(stats.cols / selected.getWidth(), 2), 10, y);
+		y += 20;
+		ofDrawBitmapStringHighlight("history " + ofToString(stats.historyFrames) + "/" + ofToString(pipeline.getHistoryDepth()) +
+			" frames  " + ofToString(int(stats.historyBytes >> 20)) + "MB", 10, y);
+		y += 20;
+		if (streams.size() > 1) {
+			ofDrawBitmapStringHighlight("stream " + selected.getName() +
+				"  priority " + ofToString(int(pipeline.getPriority())) +
+				"  deadline " + ofToString(pipeline.getDeadlineMs(), 1) + "ms" +
+				"  urgent " + ofToString(int(stats.urgent)) +
+				"  missed " + ofToString(int(stats.missed)), 10, y);
+			y += 20;
 		}
+#ifdef GLITCH_COUNT_ALLOCATIONS
+		ofDrawBitmapStringHighlight("allocations last frame " + ofToString(int(stats.allocations)) +
+			"  frame pool " + ofToString(int(selected.getFramePool().getBytes() >> 20)) + "MB", 10, y);
+		y += 20;
+#endif
+		y += 10;
 	}
 
-	std::vector<std::thread> threads(numThreads - 1);
-
-	for (int i = 0; i < numThreads - 1; i++) {
-
-		auto f = [=] {
-			for (int j = i * countPerThread; j < (i + 1) * countPerThread; j++) {
-				if (noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4 + 3]) {
-					OutResult.data[3 * j] = 255 - (InMat.data[3 * j] * 0.5 + 0.5 * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4]);
-					OutResult.data[3 * j + 1] = 255 - (InMat.data[3 * j + 1] * 0.5 + 0.5 * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4 + 1]);
-					OutResult.data[3 * j + 2] = 255 - (InMat.data[3 * j + 2] * 0.5 + 0.5 * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4 + 2]);
-				}
-				else {
-					OutResult.data[3 * j] = InMat.data[3 * j];
-					OutResult.data[3 * j + 1] = InMat.data[3 * j + 1];
-					OutResult.data[3 * j + 2] = InMat.data[3 * j + 2];
-				}
-			}
-		};
-		threads[i] = std::thread(f);
-	}
-
-	for (int j = (numThreads - 1) * countPerThread; j < InMat.cols * InMat.rows; j++) {
-		if (noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4 + 3]) {
-			OutResult.data[3 * j] = 255 - (InMat.data[3 * j] * 0.5 + 0.5 * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4]);
-			OutResult.data[3 * j + 1] = 255 - (InMat.data[3 * j + 1] * 0.5 + 0.5 * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4 + 1]);
-			OutResult.data[3 * j + 2] = 255 - (InMat.data[3 * j + 2] * 0.5 + 0.5 * noiseMat.data[(InMat.cols * ((j / InMat.cols) / rowClusterNum) + j % InMat.cols) * 4 + 2]);
+	if (toggleProfiler) {
+		for (auto& zone : getProfileZoneStats()) {
+			ofDrawBitmapStringHighlight(std::string(zone.name) +
+				"  mean " + ofToString(zone.meanMs, 3) + "ms" +
+				"  p99 " + ofToString(zone.p99Ms, 3) + "ms" +
+				"  x" + ofToString(zone.calls, 1), 10, y);
+			y += 20;
+		}
+		for (auto& thread : getProfileThreadStats()) {
+			ofDrawBitmapStringHighlight(thread.name + "  busy " + ofToString(thread.utilization * 100, 0) + "%", 10, y);
+			y += 20;
 		}
-		else {
-			OutResult.data[3 * j] = InMat.data[3 * j];
-			OutResult.data[3 * j + 1] = InMat.data[3 * j + 1];
-			OutResult.data[3 * j + 2] = InMat.data[3 * j + 2];
+		if (isProfileTraceRunning()) {
+			ofDrawBitmapStringHighlight("recording trace", 10, y);
+			y += 20;
 		}
+		y += 10;
 	}
 
-	for (auto& entry : threads) {
-		entry.join();
+	if (togglePoolStats) {
+		//Cumulative since start: tasks run, tasks stolen from other workers, time spent waiting for work (callers: for
+		//their jobs to finish).
+		auto stats = threadPool->getStats();
+		for (size_t i = 0; i < stats.size(); i++) {
+			bool caller = i == 0 || i >= threadPool->size();
+			ofDrawBitmapStringHighlight((caller ? "caller " : "worker ") + ofToString(int(i)) +
+				"  run " + ofToString(int(stats[i].tasksRun)) +
+				"  stolen " + ofToString(int(stats[i].tasksStolen)) +
+				"  idle " + ofToString(stats[i].idleSeconds, 2) + "s", 10, y);
+			y += 20;
+		}
 	}
 }
 
+//--------------------------------------------------------------
+void ofApp::dumpTrace() {
+	toggleProfiler = true;
+	setProfilingEnabled(true);
+	startProfileTrace(sliderTraceFrames, ofToDataPath("trace_" + ofGetTimestampString() + ".json"));
+}
+
+//--------------------------------------------------------------
+void ofApp::exit(){
+	for (auto& stream : streams) {
+		stream->stop();
+	}
+}
@@ -4,6 +4,13 @@
 #include "ofxCv.h"
 #include "ofxOpenCv.h"
 #include "ofxGui.h"
+#include "Postprocess.h"
+#include "EffectChain.h"
+#include "FramePipeline.h"
+#include "GlitchStream.h"
+#include "AllocationCounter.h"
+#include "GlitchRandom.h"
+#include "Profiler.h"
 
 using namespace ofxCv;
 using namespace cv;
@@ -11,19 +18,29 @@ using namespace cv;
 class ofApp : public ofBaseApp{
 
 	public:
+		//One stream from the default camera unless the command line gives others.
+		explicit ofApp(const std::vector<StreamSettings>& streamSettings = std::vector<StreamSettings>(1)) : streamSettings(streamSettings) {}
+
 		void setup();
 		void update();
 		void draw();
+		void exit();
 		
-		//Input image
-		ofImage img;
-		Mat matImg;
-		Mat matResult;
-		Mat matMask;
-		Mat matMaskPre;
-
-		//Video input.
-		ofVideoGrabber videoGrabber;
+		//Shared by the merge pass and every postprocess of every stream. Declared before the streams
+		//so that their pipelines stop first.
+		std::unique_ptr<ThreadPool> threadPool;
+
+		//Every screen of the installation, drawn side by side. The GUI edits the selected one,
+		//the pipeline settings apply to all of them.
+		std::vector<StreamSettings> streamSettings;
+		std::vector<std::unique_ptr<GlitchStream>> streams;
+		GlitchStream& getStream() { return *streams[sliderStream]; }
+		ofxIntSlider sliderStream;
+		void streamChanged(int& index);
+
+		//Puts the planes of planar frames back together while drawing.
+		ofShader shaderPlanes;
+
 		ofxPanel gui;
 		ofxFloatSlider alphaCam;
 
@@ -37,10 +54,88 @@ class ofApp : public ofBaseApp{
 		ofxButton btnLine;
 		ofxButton btnDigitalSprite;
 		ofxButton btnIntDigitalSprite;
+		ofxButton btnTimeScanLine;
+		ofxButton btnFreezeBlock;
+		//Earlier frames the selected stream keeps for the two above.
+		ofxIntSlider sliderHistory;
+		void historyChanged(int& frames) {
+			getStream().setHistoryDepth(frames);
+		};
+		ofxToggle togglePoolStats;
+		ofxToggle toggleChain;
+		ofxButton btnClearChain;
+		ofxLabel labelChain;
+		ofxLabel labelSeed;
+		ofxIntSlider sliderPipelineDepth;
+		ofxToggle togglePipelineStats;
+		void pipelineDepthChanged(int& depth) {
+			for (auto& stream : streams) {
+				stream->getPipeline().setMaxInFlight(depth);
+			}
+			FramePipeline::markReconfigured();
+		};
+		ofxIntSlider sliderMaskScale;
+		void maskScaleChanged(int& scale) {
+			for (auto& stream : streams) {
+				stream->getPipeline().setMaskScale(scale);
+			}
+			FramePipeline::markReconfigured();
+		};
+		ofxToggle toggleAdaptive;
+		void adaptiveChanged(bool& enabled) {
+			for (auto& stream : streams) {
+				stream->getPipeline().setAdaptiveResolution(enabled);
+			}
+			FramePipeline::markReconfigured();
+		};
+		ofxFloatSlider sliderBudget;
+		void budgetChanged(float& ms) {
+			for (auto& stream : streams) {
+				stream->getPipeline().setFrameBudgetMs(ms);
+			}
+		};
+
+		ofxToggle togglePlanar;
+		void planarChanged(bool& enabled) {
+			for (auto& stream : streams) {
+				stream->getPipeline().setPlanar(enabled);
+			}
+			FramePipeline::markReconfigured();
+		};
+		//Scheduling of the selected stream on the shared pool, only shown with several streams.
+		ofxIntSlider sliderPriority;
+		void priorityChanged(int& level) {
+			getStream().getPipeline().setPriority(ThreadPool::Level(level));
+		};
+		ofxFloatSlider sliderDeadline;
+		void deadlineChanged(float& ms) {
+			getStream().getPipeline().setDeadlineMs(ms);
+		};
+		//Records the selected stream on background threads, see FrameRecorder.
+		ofxToggle toggleRecord;
+		void recordChanged(bool& enabled);
+		ofxIntSlider sliderRecordFormat;
+		ofxToggle toggleProfiler;
+		void profilerChanged(bool& enabled) {
+			setProfilingEnabled(enabled);
+		};
+		ofxIntSlider sliderTraceFrames;
+		ofxButton btnDumpTrace;
+		void dumpTrace();
+
+		//Effects stacked while "Chain Effects" is on, in click order.
+		void clearChain() {
+			getStream().clearChain();
+			labelChain = "";
+		};
 
 		//Postprocess Func
-		void (*_Postprocess)(Mat&, const Mat&, float);
 		template<void (*Func)(Mat&, const Mat&, float)>
-			void setPostProcessMethod() { _Postprocess = Func; };
+			void setPostProcessMethod() {
+				getStream().setPostprocess(Func, toggleChain);
+				if (toggleChain) {
+					labelChain = getStream().describeChain();
+				}
+			};
 		
 };